@@ -0,0 +1,34 @@
+#!/bin/sh
+#
+# contention.sh
+# Multithreaded OS Simulation for ECE 3056
+#
+# Compares scheduler lock wait time with one global run queue against
+# per-CPU run queues (-l) as the number of simulated CPUs grows, along
+# with the wait time on the simulator's own simulator_mutex.
+#
+# Usage: bench/contention.sh [scheduler flag] [# CPUs ...]
+#        e.g. bench/contention.sh -p 1 4 16
+#        (run from the top of the tree after 'make')
+
+SIM=${SIM:-./os-sim}
+POLICY=${1:--f}
+[ $# -gt 0 ] && shift
+CPUS=${*:-"1 4 16"}
+
+printf "%-6s %-8s %12s %12s %12s %14s %14s\n" "CPUs" "queues" "acquired" "contended" "wait (us)" "run wait (us)" "sim wait (us)"
+printf "%-6s %-8s %12s %12s %12s %14s %14s\n" "====" "======" "========" "=========" "=========" "=============" "============="
+for cpus in $CPUS
+do
+    for queues in global per-cpu
+    do
+        flags="-c"
+        [ "$queues" = per-cpu ] && flags="-c -l"
+        # shellcheck disable=SC2086
+        "$SIM" $POLICY $flags "$cpus" | awk -v cpus="$cpus" -v queues="$queues" '
+            $1 == "running_processes" { run_wait = $4 }
+            $1 == "runqueue" && $2 == "(all)" { acq = $3; cont = $4; wait = $5 }
+            $1 == "simulator_mutex" { sim_wait = $4 }
+            END { printf "%-6s %-8s %12s %12s %12s %14s %14s\n", cpus, queues, acq, cont, wait, run_wait, sim_wait }'
+    done
+done
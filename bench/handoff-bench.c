@@ -0,0 +1,221 @@
+/*
+ * handoff-bench.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Measures how many events per second the supervisor can hand to CPU
+ * threads, for the condition variable handshake simulator_cpu_event() used
+ * to do and for the eventcount slot it uses now.
+ *
+ * Both replay the simulator's protocol: the supervisor visits the CPUs in
+ * order, posts an event to each and waits until that CPU's thread has run
+ * its handler and gone back to waiting.  The handler takes the simulator
+ * mutex once, as context_switch() does.
+ *
+ * Usage: handoff-bench [events per measurement]
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "eventcount.h"
+
+
+typedef enum {
+    CPU_IDLE = 0,
+    CPU_RUNNING,
+    CPU_PREEMPT,
+    CPU_EXIT
+} cpu_state_t;
+
+typedef struct {
+    cpu_state_t state;
+    pthread_cond_t wakeup;
+    eventcount_t event;
+    eventcount_t done;
+    pthread_t thread;
+} __attribute__((aligned(64))) cpu_t;
+
+
+static pthread_mutex_t simulator_mutex = PTHREAD_MUTEX_INITIALIZER;
+static cpu_t *cpus;
+static unsigned long handled;
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void handler(void)
+{
+    pthread_mutex_lock(&simulator_mutex);
+    handled++;
+    pthread_mutex_unlock(&simulator_mutex);
+}
+
+
+/* The old handoff: everything under simulator_mutex, one condvar per CPU */
+static void *condvar_cpu(void *data)
+{
+    cpu_t *cpu = data;
+    cpu_state_t state;
+
+    while (1)
+    {
+        pthread_mutex_lock(&simulator_mutex);
+        pthread_cond_signal(&cpu->wakeup);
+        cpu->state = CPU_RUNNING;
+        while (cpu->state == CPU_RUNNING)
+            pthread_cond_wait(&cpu->wakeup, &simulator_mutex);
+        state = cpu->state;
+        pthread_mutex_unlock(&simulator_mutex);
+
+        if (state == CPU_EXIT)
+        {
+            pthread_mutex_lock(&simulator_mutex);
+            pthread_cond_signal(&cpu->wakeup);
+            pthread_mutex_unlock(&simulator_mutex);
+            return NULL;
+        }
+        handler();
+    }
+}
+
+/* Called with simulator_mutex held */
+static void condvar_event(cpu_t *cpu, cpu_state_t state)
+{
+    cpu->state = state;
+    pthread_cond_signal(&cpu->wakeup);
+    pthread_cond_wait(&cpu->wakeup, &simulator_mutex);
+}
+
+
+/* The new handoff: state published atomically, an eventcount each way */
+static void *eventcount_cpu(void *data)
+{
+    cpu_t *cpu = data;
+    cpu_state_t state;
+    unsigned int key;
+
+    while (1)
+    {
+        pthread_mutex_lock(&simulator_mutex);
+        state = CPU_RUNNING;
+        __atomic_store_n(&cpu->state, state, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&simulator_mutex);
+        eventcount_signal(&cpu->done);
+
+        while (state == CPU_RUNNING)
+        {
+            key = eventcount_prepare(&cpu->event);
+            state = __atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE);
+            if (state == CPU_RUNNING)
+                eventcount_wait(&cpu->event, key);
+        }
+
+        if (state == CPU_EXIT)
+        {
+            eventcount_signal(&cpu->done);
+            return NULL;
+        }
+        handler();
+    }
+}
+
+/* Called with simulator_mutex held */
+static void eventcount_event(cpu_t *cpu, cpu_state_t state)
+{
+    unsigned int key;
+
+    __atomic_store_n(&cpu->state, state, __ATOMIC_RELEASE);
+    eventcount_signal(&cpu->event);
+    pthread_mutex_unlock(&simulator_mutex);
+    while (1)
+    {
+        key = eventcount_prepare(&cpu->done);
+        state = __atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE);
+        if (state == CPU_RUNNING || state == CPU_EXIT)
+            break;
+        eventcount_wait(&cpu->done, key);
+    }
+    pthread_mutex_lock(&simulator_mutex);
+}
+
+
+static double bench(unsigned int cpu_count, unsigned long events,
+    void *(*cpu_func)(void *), void (*event)(cpu_t *, cpu_state_t))
+{
+    unsigned long n;
+    unsigned int id;
+    double start, elapsed;
+
+    cpus = NULL;
+    if (posix_memalign((void **)&cpus, 64, sizeof(cpu_t) * cpu_count) != 0)
+        exit(1);
+    for (id = 0; id < cpu_count; id++)
+    {
+        cpus[id].state = CPU_IDLE;
+        pthread_cond_init(&cpus[id].wakeup, NULL);
+        eventcount_init(&cpus[id].event);
+        eventcount_init(&cpus[id].done);
+        pthread_create(&cpus[id].thread, NULL, cpu_func, &cpus[id]);
+    }
+
+    /* Wait for every CPU to start "running" */
+    pthread_mutex_lock(&simulator_mutex);
+    for (id = 0; id < cpu_count; id++)
+    {
+        while (cpus[id].state != CPU_RUNNING)
+        {
+            pthread_mutex_unlock(&simulator_mutex);
+            sched_yield();
+            pthread_mutex_lock(&simulator_mutex);
+        }
+    }
+
+    handled = 0;
+    start = now_ns();
+    for (n = 0; n < events; n++)
+        event(&cpus[n % cpu_count], CPU_PREEMPT);
+    elapsed = now_ns() - start;
+
+    for (id = 0; id < cpu_count; id++)
+        event(&cpus[id], CPU_EXIT);
+    pthread_mutex_unlock(&simulator_mutex);
+    for (id = 0; id < cpu_count; id++)
+    {
+        pthread_join(cpus[id].thread, NULL);
+        pthread_cond_destroy(&cpus[id].wakeup);
+    }
+    free(cpus);
+
+    if (handled != events)
+    {
+        fprintf(stderr, "Lost events: %lu of %lu handled\n", handled, events);
+        exit(1);
+    }
+    return (double)events / (elapsed / 1e9);
+}
+
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int cpu_counts[] = { 1, 4, 16 };
+    unsigned long events = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    unsigned int n;
+
+    printf("%-6s %22s %22s\n", "CPUs", "condvar (events/s)", "eventcount (events/s)");
+    printf("%-6s %22s %22s\n", "======", "==================", "=====================");
+
+    for (n = 0; n < sizeof(cpu_counts) / sizeof(cpu_counts[0]); n++)
+        printf("%-6u %22.0f %22.0f\n", cpu_counts[n],
+            bench(cpu_counts[n], events, condvar_cpu, condvar_event),
+            bench(cpu_counts[n], events, eventcount_cpu, eventcount_event));
+
+    return 0;
+}
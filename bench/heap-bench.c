@@ -0,0 +1,137 @@
+/*
+ * heap-bench.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Measures the cost of picking the best-priority process as the ready queue
+ * grows, for the indexed heap used by the PRIORITYQ scheduler and for the
+ * two-pass linked-list scan it replaced.
+ *
+ * Each measurement keeps the queue at a fixed size: pick the best process,
+ * then put it back with a new priority, as a CPU does on every preemption.
+ *
+ * Usage: heap-bench [max queue size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "heap.h"
+
+
+#define PRIORITY_LEVELS 140
+
+typedef struct _node {
+    unsigned int id;
+    int priority;
+    struct _node *next;
+} node_t;
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int random_priority(void)
+{
+    return rand() % PRIORITY_LEVELS;
+}
+
+/* The old schedule(): one pass for the best priority, one for its predecessor */
+static node_t *list_pick(node_t **head)
+{
+    node_t *iter = *head, *prev = NULL, *best;
+    int best_priority = iter->priority;
+
+    for (; iter != NULL; iter = iter->next)
+        if (iter->priority < best_priority)
+            best_priority = iter->priority;
+
+    for (iter = *head; iter->priority != best_priority; iter = iter->next)
+        prev = iter;
+
+    best = iter;
+    if (prev == NULL)
+        *head = best->next;
+    else
+        prev->next = best->next;
+    best->next = NULL;
+    return best;
+}
+
+static double bench_list(unsigned int size, unsigned int picks)
+{
+    node_t *nodes = malloc(sizeof(node_t) * size), *head = NULL, *picked;
+    unsigned int n;
+    double start, elapsed;
+
+    for (n = 0; n < size; n++)
+    {
+        nodes[n].id = n;
+        nodes[n].priority = random_priority();
+        nodes[n].next = head;
+        head = &nodes[n];
+    }
+
+    start = now_ns();
+    for (n = 0; n < picks; n++)
+    {
+        picked = list_pick(&head);
+        picked->priority = random_priority();
+        picked->next = head;
+        head = picked;
+    }
+    elapsed = now_ns() - start;
+
+    free(nodes);
+    return elapsed / picks;
+}
+
+static double bench_heap(unsigned int size, unsigned int picks)
+{
+    heap_t heap;
+    unsigned int n, id;
+    double start, elapsed;
+
+    heap_init(&heap, size);
+    for (n = 0; n < size; n++)
+        heap_push(&heap, n, random_priority());
+
+    start = now_ns();
+    for (n = 0; n < picks; n++)
+    {
+        id = heap_pop(&heap);
+        heap_push(&heap, id, random_priority());
+    }
+    elapsed = now_ns() - start;
+
+    heap_destroy(&heap);
+    return elapsed / picks;
+}
+
+
+int main(int argc, char *argv[])
+{
+    unsigned int max_size = argc > 1 ? (unsigned int)atoi(argv[1]) : 1u << 20;
+    unsigned int size, picks;
+
+    srand(3056);
+    printf("%-10s %16s %16s\n", "ready", "list scan (ns)", "heap (ns)");
+    printf("%-10s %16s %16s\n", "==========", "==============", "=========");
+
+    for (size = 8; size <= max_size; size *= 4)
+    {
+        /* Keep each row to a few hundred milliseconds */
+        picks = size <= 4096 ? 200000 : 200000000 / size;
+        if (size <= 65536)
+            printf("%-10u %16.1f %16.1f\n", size, bench_list(size, picks),
+                bench_heap(size, 1000000));
+        else
+            printf("%-10u %16s %16.1f\n", size, "-", bench_heap(size, 1000000));
+    }
+
+    return 0;
+}
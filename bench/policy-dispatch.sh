@@ -0,0 +1,48 @@
+#!/bin/sh
+#
+# policy-dispatch.sh
+# Multithreaded OS Simulation for ECE 3056
+#
+# Compares the generic simulator, which calls every policy hook through the
+# sched_policy_t selected at run time, against the builds specialized for
+# one policy with 'make sched-<name>'.  Each binary is run RUNS times and
+# the mean wall time per run is reported.  The generic binary is
+# os-sim-generic, built with the same flags (-flto included) as the
+# specialized ones, so only the policy dispatch differs.
+#
+# Usage: bench/policy-dispatch.sh [# CPUs]
+#        e.g. RUNS=200 bench/policy-dispatch.sh 4
+#        (run from the top of the tree after 'make sched-all')
+
+SIM=${SIM:-./os-sim}
+GENERIC=${GENERIC:-$SIM-generic}
+RUNS=${RUNS:-100}
+CPUS=${1:-4}
+
+# Runs "$@" RUNS times and prints the mean wall time in microseconds
+time_runs()
+{
+    start=$(date +%s%N)
+    i=0
+    while [ $i -lt "$RUNS" ]
+    do
+        "$@" > /dev/null 2>&1
+        i=$((i + 1))
+    done
+    end=$(date +%s%N)
+    echo $(((end - start) / 1000 / RUNS))
+}
+
+printf "%-6s %-10s %14s %14s %8s\n" "policy" "flags" "generic (us)" "special (us)" "ratio"
+printf "%-6s %-10s %14s %14s %8s\n" "======" "=====" "============" "============" "====="
+for spec in "fcfs -f" "rr -r 3" "prio -p" "sjf -s" "mlfq -m 3" "o1 -o 3" "cfs -v"
+do
+    # shellcheck disable=SC2086
+    set -- $spec
+    name=$1
+    shift
+    generic=$(time_runs "$GENERIC" "$@" "$CPUS")
+    special=$(time_runs "$SIM-$name" "$@" "$CPUS")
+    printf "%-6s %-10s %14s %14s %8s\n" "$name" "$*" "$generic" "$special" \
+        "$(awk -v g="$generic" -v s="$special" 'BEGIN { printf "%.3f", (s > 0) ? g / s : 0 }')"
+done
@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# rr-sweep.sh
+# Multithreaded OS Simulation for ECE 3056
+#
+# Runs the round-robin scheduler once per timeslice and tabulates context
+# switches, total execution time and time spent in READY, to pick the
+# quantum with the best throughput/latency trade-off.
+#
+# Usage: bench/rr-sweep.sh [# CPUs] [timeslice ...]
+#        (run from the top of the tree after 'make')
+
+SIM=${SIM:-./os-sim}
+CPUS=${1:-1}
+[ $# -gt 0 ] && shift
+SLICES=${*:-"1 2 3 4 5 6 8 10 15 20"}
+
+printf "%-10s %10s %12s %12s\n" "timeslice" "switches" "exec (s)" "READY (s)"
+printf "%-10s %10s %12s %12s\n" "=========" "========" "========" "========="
+for slice in $SLICES
+do
+    "$SIM" -r "$slice" "$CPUS" | awk -v slice="$slice" '
+        /^# of Context Switches:/           { switches = $5 }
+        /^Total execution time:/            { exec = $4 }
+        /^Total time spent in READY state:/ { ready = $7 }
+        END { printf "%-10s %10s %12s %12s\n", slice, switches, exec, ready }'
+done
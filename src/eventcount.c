@@ -0,0 +1,104 @@
+/*
+ * eventcount.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Spin-then-park eventcount.  See eventcount.h.
+ */
+
+#include <limits.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+#include "eventcount.h"
+
+
+/* Polls of the count before parking, on a machine with more than one core */
+#define EVENTCOUNT_SPINS 1000
+
+/*
+ * With a single core the thread that would move the count cannot run while
+ * we spin, so we park straight away.  Set by the first eventcount_init(),
+ * which is called before any waiter exists.
+ */
+static int eventcount_spins = -1;
+
+
+#ifdef __linux__
+static void eventcount_park(eventcount_t *ec, unsigned int key)
+{
+    /* Returns at once if the count has already moved past key */
+    syscall(SYS_futex, &ec->seq, FUTEX_WAIT_PRIVATE, key, NULL, NULL, 0);
+}
+
+static void eventcount_unpark(eventcount_t *ec)
+{
+    syscall(SYS_futex, &ec->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#else
+static void eventcount_park(eventcount_t *ec, unsigned int key)
+{
+    pthread_mutex_lock(&ec->mutex);
+    if (__atomic_load_n(&ec->seq, __ATOMIC_SEQ_CST) == key)
+        pthread_cond_wait(&ec->cond, &ec->mutex);
+    pthread_mutex_unlock(&ec->mutex);
+}
+
+static void eventcount_unpark(eventcount_t *ec)
+{
+    pthread_mutex_lock(&ec->mutex);
+    pthread_cond_broadcast(&ec->cond);
+    pthread_mutex_unlock(&ec->mutex);
+}
+#endif
+
+
+extern void eventcount_init(eventcount_t *ec)
+{
+    ec->seq = 0;
+    ec->waiters = 0;
+#ifndef __linux__
+    pthread_mutex_init(&ec->mutex, NULL);
+    pthread_cond_init(&ec->cond, NULL);
+#endif
+
+    if (eventcount_spins < 0)
+        eventcount_spins = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? EVENTCOUNT_SPINS : 0;
+}
+
+extern unsigned int eventcount_prepare(eventcount_t *ec)
+{
+    return __atomic_load_n(&ec->seq, __ATOMIC_ACQUIRE);
+}
+
+extern void eventcount_wait(eventcount_t *ec, unsigned int key)
+{
+    int n;
+
+    for (n = 0; n < eventcount_spins; n++)
+    {
+        if (__atomic_load_n(&ec->seq, __ATOMIC_ACQUIRE) != key)
+            return;
+        cpu_relax();
+    }
+
+    /*
+     * Announcing ourselves before the final check of seq pairs with
+     * eventcount_signal() moving seq before it looks at waiters: either it
+     * sees us and wakes us, or we see the new count.
+     */
+    __atomic_add_fetch(&ec->waiters, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&ec->seq, __ATOMIC_SEQ_CST) == key)
+        eventcount_park(ec, key);
+    __atomic_sub_fetch(&ec->waiters, 1, __ATOMIC_SEQ_CST);
+}
+
+extern void eventcount_signal(eventcount_t *ec)
+{
+    __atomic_add_fetch(&ec->seq, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->waiters, __ATOMIC_SEQ_CST) != 0)
+        eventcount_unpark(ec);
+}
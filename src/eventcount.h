@@ -0,0 +1,57 @@
+/*
+ * eventcount.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * An eventcount: a counter that waiters sleep on until it moves.  It carries
+ * no condition of its own; it makes waiting on one lock-free.  A waiter
+ * reads the count, checks its condition, and only if the condition does not
+ * hold waits for the count to move:
+ *
+ *     key = eventcount_prepare(&ec);
+ *     if (!condition)
+ *         eventcount_wait(&ec, key);
+ *
+ * and whoever makes the condition true calls eventcount_signal() after
+ * doing so.  A signal between prepare and wait is not lost.
+ *
+ * eventcount_wait() spins briefly before parking, since the simulator's
+ * handoffs are usually answered within a few microseconds.  Parking uses a
+ * futex on Linux and a mutex and condition variable elsewhere;
+ * eventcount_signal() makes no system call while nobody is parked.
+ */
+
+#ifndef __EVENTCOUNT_H__
+#define __EVENTCOUNT_H__
+
+#ifndef __linux__
+#include <pthread.h>
+#endif
+
+
+typedef struct {
+    unsigned int seq;           /* the futex word */
+    unsigned int waiters;       /* threads parked, or about to park */
+#ifndef __linux__
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+} eventcount_t;
+
+
+/* cpu_relax() is the processor's spin-wait hint, for polling loops */
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax() do { } while (0)
+#endif
+
+
+extern void eventcount_init(eventcount_t *ec);
+extern unsigned int eventcount_prepare(eventcount_t *ec);
+extern void eventcount_wait(eventcount_t *ec, unsigned int key);
+extern void eventcount_signal(eventcount_t *ec);
+
+
+#endif /* __EVENTCOUNT_H__ */
@@ -0,0 +1,63 @@
+/*
+ * fifo.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Head/tail FIFO of PCBs.  See fifo.h.
+ */
+
+#include <stdlib.h>
+
+#include "fifo.h"
+
+
+extern void fifo_init(pcb_fifo_t *fifo)
+{
+    fifo->head = NULL;
+    fifo->tail = NULL;
+    fifo->size = 0;
+}
+
+extern void fifo_push(pcb_fifo_t *fifo, pcb_t *pcb)
+{
+    pcb->next = NULL;
+    if (fifo->tail != NULL)
+        fifo->tail->next = pcb;
+    else
+        fifo->head = pcb;
+    fifo->tail = pcb;
+    fifo->size++;
+}
+
+extern pcb_t *fifo_pop(pcb_fifo_t *fifo)
+{
+    pcb_t *pcb = fifo->head;
+
+    if (pcb == NULL)
+        return NULL;
+
+    fifo->head = pcb->next;
+    if (fifo->head == NULL)
+        fifo->tail = NULL;
+    pcb->next = NULL;
+    fifo->size--;
+    return pcb;
+}
+
+extern int fifo_empty(const pcb_fifo_t *fifo)
+{
+    return fifo->head == NULL;
+}
+
+extern void fifo_splice(pcb_fifo_t *dst, pcb_fifo_t *src)
+{
+    if (src->head == NULL)
+        return;
+
+    if (dst->tail != NULL)
+        dst->tail->next = src->head;
+    else
+        dst->head = src->head;
+    dst->tail = src->tail;
+    dst->size += src->size;
+    fifo_init(src);
+}
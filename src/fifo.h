@@ -0,0 +1,36 @@
+/*
+ * fifo.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * A head/tail FIFO of PCBs chained through pcb_t::next.  Push and pop are
+ * both O(1).  A PCB may be on at most one FIFO at a time.
+ *
+ * The FIFO does no locking of its own.
+ */
+
+#ifndef __FIFO_H__
+#define __FIFO_H__
+
+#include "os-sim.h"
+
+
+typedef struct {
+    pcb_t *head;
+    pcb_t *tail;
+    unsigned int size;
+} pcb_fifo_t;
+
+
+extern void fifo_init(pcb_fifo_t *fifo);
+extern void fifo_push(pcb_fifo_t *fifo, pcb_t *pcb);
+
+/* fifo_pop() returns NULL on an empty FIFO. */
+extern pcb_t *fifo_pop(pcb_fifo_t *fifo);
+
+extern int fifo_empty(const pcb_fifo_t *fifo);
+
+/* fifo_splice() moves every PCB on src to the tail of dst in O(1). */
+extern void fifo_splice(pcb_fifo_t *dst, pcb_fifo_t *src);
+
+
+#endif /* __FIFO_H__ */
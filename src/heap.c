@@ -0,0 +1,141 @@
+/*
+ * heap.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Indexed binary min-heap.  See heap.h.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "heap.h"
+
+
+/* Returns nonzero if the id at position a must sit above the id at b */
+static int heap_before(const heap_t *heap, unsigned int a, unsigned int b)
+{
+    unsigned int id_a = heap->slot[a], id_b = heap->slot[b];
+
+    if (heap->key[id_a] != heap->key[id_b])
+        return heap->key[id_a] < heap->key[id_b];
+    return heap->seq[id_a] < heap->seq[id_b];
+}
+
+static void heap_swap(heap_t *heap, unsigned int a, unsigned int b)
+{
+    unsigned int id = heap->slot[a];
+
+    heap->slot[a] = heap->slot[b];
+    heap->slot[b] = id;
+    heap->pos[heap->slot[a]] = a;
+    heap->pos[heap->slot[b]] = b;
+}
+
+static void heap_sift_up(heap_t *heap, unsigned int i)
+{
+    while (i > 0 && heap_before(heap, i, (i - 1) / 2))
+    {
+        heap_swap(heap, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_sift_down(heap_t *heap, unsigned int i)
+{
+    while (1)
+    {
+        unsigned int left = 2 * i + 1, right = left + 1, best = i;
+
+        if (left < heap->size && heap_before(heap, left, best))
+            best = left;
+        if (right < heap->size && heap_before(heap, right, best))
+            best = right;
+        if (best == i)
+            return;
+        heap_swap(heap, i, best);
+        i = best;
+    }
+}
+
+
+extern void heap_init(heap_t *heap, unsigned int capacity)
+{
+    unsigned int n;
+
+    heap->slot = malloc(sizeof(unsigned int) * capacity);
+    heap->pos = malloc(sizeof(unsigned int) * capacity);
+    heap->key = malloc(sizeof(long) * capacity);
+    heap->seq = malloc(sizeof(unsigned long) * capacity);
+    assert(heap->slot != NULL && heap->pos != NULL);
+    assert(heap->key != NULL && heap->seq != NULL);
+
+    for (n = 0; n < capacity; n++)
+        heap->pos[n] = HEAP_NOT_QUEUED;
+    heap->next_seq = 0;
+    heap->size = 0;
+    heap->capacity = capacity;
+}
+
+extern void heap_destroy(heap_t *heap)
+{
+    free(heap->slot);
+    free(heap->pos);
+    free(heap->key);
+    free(heap->seq);
+    heap->size = 0;
+    heap->capacity = 0;
+}
+
+extern void heap_push(heap_t *heap, unsigned int id, long key)
+{
+    assert(id < heap->capacity);
+    assert(heap->pos[id] == HEAP_NOT_QUEUED);
+
+    heap->key[id] = key;
+    heap->seq[id] = heap->next_seq++;
+    heap->slot[heap->size] = id;
+    heap->pos[id] = heap->size;
+    heap->size++;
+    heap_sift_up(heap, heap->size - 1);
+}
+
+extern unsigned int heap_pop(heap_t *heap)
+{
+    unsigned int id = heap_peek(heap);
+
+    if (id != HEAP_NOT_QUEUED)
+        heap_remove(heap, id);
+    return id;
+}
+
+extern unsigned int heap_peek(const heap_t *heap)
+{
+    return heap->size > 0 ? heap->slot[0] : HEAP_NOT_QUEUED;
+}
+
+extern void heap_remove(heap_t *heap, unsigned int id)
+{
+    unsigned int i;
+
+    assert(heap_contains(heap, id));
+    i = heap->pos[id];
+    heap->size--;
+    if (i != heap->size)
+    {
+        /* Move the last element into the hole, then restore the order */
+        heap_swap(heap, i, heap->size);
+        heap_sift_up(heap, i);
+        heap_sift_down(heap, i);
+    }
+    heap->pos[id] = HEAP_NOT_QUEUED;
+}
+
+extern int heap_contains(const heap_t *heap, unsigned int id)
+{
+    return id < heap->capacity && heap->pos[id] != HEAP_NOT_QUEUED;
+}
+
+extern int heap_empty(const heap_t *heap)
+{
+    return heap->size == 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * heap.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * An indexed binary min-heap over small integer ids (PIDs, CPU ids, ...).
+ *
+ * Every id carries a key.  The heap keeps the id with the smallest key at the
+ * root; ids with equal keys come out in the order they were pushed.  Because
+ * the heap also remembers where each id is stored, an arbitrary id can be
+ * removed in O(log n) as well.  For max-heap behaviour, push negated keys.
+ *
+ * The heap does no locking of its own.
+ */
+
+#ifndef __HEAP_H__
+#define __HEAP_H__
+
+
+#define HEAP_NOT_QUEUED ((unsigned int)-1)
+
+typedef struct {
+    unsigned int *slot;         /* slot[i] : id stored at heap position i */
+    unsigned int *pos;          /* pos[id] : heap position of id, or HEAP_NOT_QUEUED */
+    long *key;                  /* key[id] : ordering key of id */
+    unsigned long *seq;         /* seq[id] : push order, breaks ties FIFO */
+    unsigned long next_seq;
+    unsigned int size;
+    unsigned int capacity;      /* ids must be < capacity */
+} heap_t;
+
+
+extern void heap_init(heap_t *heap, unsigned int capacity);
+extern void heap_destroy(heap_t *heap);
+
+/* heap_push() inserts id, which must not already be queued. */
+extern void heap_push(heap_t *heap, unsigned int id, long key);
+
+/* heap_pop() and heap_peek() return HEAP_NOT_QUEUED on an empty heap. */
+extern unsigned int heap_pop(heap_t *heap);
+extern unsigned int heap_peek(const heap_t *heap);
+
+/* heap_remove() takes id out of the heap, wherever it is. */
+extern void heap_remove(heap_t *heap, unsigned int id);
+
+extern int heap_contains(const heap_t *heap, unsigned int id);
+extern int heap_empty(const heap_t *heap);
+
+
+#endif /* __HEAP_H__ */
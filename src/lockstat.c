@@ -0,0 +1,250 @@
+/*
+ * lockstat.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Opt-in lock instrumentation.  See lockstat.h.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstat.h"
+
+
+#define LOCKSTAT_FAMILY_ROWS 16     /* families larger than this print only the total */
+
+int lockstat_enabled = 0;
+
+static unsigned int lockstat_threads;
+static lockstat_t *lockstat_head = NULL, *lockstat_tail = NULL;
+static __thread unsigned int lockstat_thread;
+
+
+static unsigned long lockstat_elapsed(const struct timespec *start, const struct timespec *end)
+{
+    return (unsigned long)((end->tv_sec - start->tv_sec) * 1000000000l
+        + (end->tv_nsec - start->tv_nsec));
+}
+
+static lockstat_slot_t *lockstat_slot(lockstat_t *ls)
+{
+    assert(lockstat_thread < lockstat_threads);
+    return &ls->slots[lockstat_thread];
+}
+
+static void lockstat_add(lockstat_slot_t *total, const lockstat_slot_t *slot)
+{
+    total->acquisitions += slot->acquisitions;
+    total->contended += slot->contended;
+    total->wait_ns += slot->wait_ns;
+    total->hold_ns += slot->hold_ns;
+}
+
+static void lockstat_sum(const lockstat_t *ls, lockstat_slot_t *total)
+{
+    unsigned int n;
+
+    for (n = 0; n < lockstat_threads; n++)
+        lockstat_add(total, &ls->slots[n]);
+}
+
+static void lockstat_print_row(const char *name, const lockstat_slot_t *slot)
+{
+    printf("  %-24s %10lu %10lu %12.1f %12.1f\n", name, slot->acquisitions,
+        slot->contended, (double)slot->wait_ns / 1000.0, (double)slot->hold_ns / 1000.0);
+}
+
+
+extern void lockstat_enable(unsigned int nthreads)
+{
+    assert(lockstat_head == NULL && nthreads > 0);
+    lockstat_threads = nthreads;
+    lockstat_enabled = 1;
+}
+
+extern void lockstat_register(lockstat_t *ls, const char *name, int instance)
+{
+    ls->name = name;
+    ls->instance = instance;
+    ls->slots = NULL;
+    ls->next = NULL;
+    if (!lockstat_enabled)
+        return;
+
+    if (posix_memalign((void **)&ls->slots, sizeof(lockstat_slot_t),
+        sizeof(lockstat_slot_t) * lockstat_threads) != 0)
+        assert(0);
+    memset(ls->slots, 0, sizeof(lockstat_slot_t) * lockstat_threads);
+
+    if (lockstat_tail != NULL)
+        lockstat_tail->next = ls;
+    else
+        lockstat_head = ls;
+    lockstat_tail = ls;
+}
+
+extern void lockstat_set_thread(unsigned int thread)
+{
+    lockstat_thread = thread;
+}
+
+extern void lockstat_lock(lockstat_t *ls, pthread_mutex_t *mutex)
+{
+    lockstat_slot_t *slot;
+
+    if (!lockstat_enabled)
+    {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+
+    /* The clock is only read before acquiring when the lock is busy */
+    slot = lockstat_slot(ls);
+    slot->waited = 0;
+    if (pthread_mutex_trylock(mutex) != 0)
+    {
+        struct timespec start, now;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        pthread_mutex_lock(mutex);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        slot->wait_ns += lockstat_elapsed(&start, &now);
+        slot->contended++;
+        slot->waited = 1;
+        if (slot->depth == 0)
+            slot->since = now;
+    }
+    else if (slot->depth == 0)
+        clock_gettime(CLOCK_MONOTONIC, &slot->since);
+    slot->depth++;
+    slot->acquisitions++;
+}
+
+extern void lockstat_unlock(lockstat_t *ls, pthread_mutex_t *mutex)
+{
+    if (lockstat_enabled)
+    {
+        lockstat_slot_t *slot = lockstat_slot(ls);
+        struct timespec now;
+
+        if (--slot->depth == 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            slot->hold_ns += lockstat_elapsed(&slot->since, &now);
+        }
+    }
+    pthread_mutex_unlock(mutex);
+}
+
+extern void lockstat_cond_wait(lockstat_t *ls, pthread_cond_t *cond,
+    pthread_mutex_t *mutex, int contended)
+{
+    lockstat_slot_t *slot;
+    struct timespec start;
+
+    if (!lockstat_enabled)
+    {
+        pthread_cond_wait(cond, mutex);
+        return;
+    }
+
+    slot = lockstat_slot(ls);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    slot->hold_ns += lockstat_elapsed(&slot->since, &start);
+    pthread_cond_wait(cond, mutex);
+    clock_gettime(CLOCK_MONOTONIC, &slot->since);
+    if (contended)
+    {
+        slot->wait_ns += lockstat_elapsed(&start, &slot->since);
+        if (!slot->waited)
+            slot->contended++;
+        slot->waited = 1;
+    }
+}
+
+extern void lockstat_print(void)
+{
+    const lockstat_t *ls, *family;
+    unsigned int n;
+    char name[48];
+
+    if (!lockstat_enabled)
+        return;
+
+    printf("Lock statistics:\n");
+    printf("  %-24s %10s %10s %12s %12s\n", "lock", "acquired", "contended", "wait (us)", "hold (us)");
+    for (ls = lockstat_head; ls != NULL; ls = family->next)
+    {
+        lockstat_slot_t total;
+        unsigned int size = 1;
+
+        /* A family is a run of registrations sharing a name, instances 0, 1, ... */
+        family = ls;
+        while (ls->instance == 0 && family->next != NULL && family->next->instance == (int)size
+            && strcmp(family->next->name, ls->name) == 0)
+        {
+            family = family->next;
+            size++;
+        }
+
+        if (ls->instance < 0)
+        {
+            memset(&total, 0, sizeof(total));
+            lockstat_sum(ls, &total);
+            lockstat_print_row(ls->name, &total);
+            continue;
+        }
+
+        memset(&total, 0, sizeof(total));
+        for (; ; ls = ls->next)
+        {
+            lockstat_slot_t row;
+
+            memset(&row, 0, sizeof(row));
+            lockstat_sum(ls, &row);
+            lockstat_add(&total, &row);
+            if (size <= LOCKSTAT_FAMILY_ROWS)
+            {
+                snprintf(name, sizeof(name), "%s %d", ls->name, ls->instance);
+                lockstat_print_row(name, &row);
+            }
+            if (ls == family)
+                break;
+        }
+        snprintf(name, sizeof(name), "%s (all)", ls->name);
+        lockstat_print_row(name, &total);
+    }
+
+    printf("Lock time by thread:\n");
+    printf("  %-24s %10s %10s %12s %12s  %s\n", "thread", "acquired", "contended", "wait (us)",
+        "hold (us)", "most waited on");
+    for (n = 0; n < lockstat_threads; n++)
+    {
+        lockstat_slot_t total;
+        const char *worst = "-";
+        unsigned long worst_ns = 0;
+
+        memset(&total, 0, sizeof(total));
+        for (ls = lockstat_head; ls != NULL; ls = ls->next)
+        {
+            lockstat_add(&total, &ls->slots[n]);
+            if (ls->slots[n].wait_ns > worst_ns)
+            {
+                worst_ns = ls->slots[n].wait_ns;
+                worst = ls->name;
+            }
+        }
+        /* Hundreds of CPUs mostly never touch a lock */
+        if (total.acquisitions == 0)
+            continue;
+        if (n == 0)
+            snprintf(name, sizeof(name), "supervisor");
+        else
+            snprintf(name, sizeof(name), "cpu %u", n - 1);
+        printf("  %-24s %10lu %10lu %12.1f %12.1f  %s\n", name, total.acquisitions,
+            total.contended, (double)total.wait_ns / 1000.0, (double)total.hold_ns / 1000.0,
+            worst);
+    }
+}
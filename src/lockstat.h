@@ -0,0 +1,85 @@
+/*
+ * lockstat.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Opt-in lock instrumentation.  A lockstat_t sits next to a pthread mutex
+ * and counts, for every thread, how often the mutex was acquired, how many
+ * of those acquisitions had to wait, the time spent waiting and the time
+ * spent holding it.  Times come from CLOCK_MONOTONIC.
+ *
+ * Until lockstat_enable() is called, lockstat_lock() and lockstat_unlock()
+ * are a flag test around the plain pthread calls.
+ *
+ * A thread can hold a lock more than once at a time: the IRWL writer side
+ * is shared, and with -d or -k every CPU's handlers run on thread 0.  Each
+ * slot keeps a depth, and only the outermost hold is timed.  An unlock with
+ * no matching lock (context_switch() from idle() releases the IRWL writer
+ * side it never took) takes the depth below zero until the matching
+ * re-lock, and adds no hold time.
+ *
+ * Threads are numbered by the simulator: 0 is the supervisor (and main),
+ * n + 1 is the thread for CPU n.  Each thread only writes its own slot, so
+ * the counters need no locking of their own.
+ */
+
+#ifndef __LOCKSTAT_H__
+#define __LOCKSTAT_H__
+
+#include <pthread.h>
+#include <time.h>
+
+
+typedef struct {
+    unsigned long acquisitions;
+    unsigned long contended;
+    unsigned long wait_ns;
+    unsigned long hold_ns;
+    struct timespec since;      /* start of the outermost current hold */
+    int depth;                  /* holds by this thread; since is valid while positive */
+    int waited;                 /* the current acquisition was counted as contended */
+} __attribute__((aligned(64))) lockstat_slot_t;
+
+typedef struct _lockstat {
+    const char *name;
+    int instance;               /* index within a family of locks, or -1 */
+    lockstat_slot_t *slots;     /* slots[thread], NULL while disabled */
+    struct _lockstat *next;
+} lockstat_t;
+
+
+extern int lockstat_enabled;
+
+/*
+ * lockstat_enable() turns instrumentation on for threads 0..nthreads-1.  It
+ * must be called before any lock is registered.
+ */
+extern void lockstat_enable(unsigned int nthreads);
+
+/*
+ * lockstat_register() names a lock for the report.  Locks registered one
+ * after another with the same name and instances 0, 1, ... are reported as
+ * a family with a total row.
+ */
+extern void lockstat_register(lockstat_t *ls, const char *name, int instance);
+
+/* lockstat_set_thread() sets the calling thread's number. */
+extern void lockstat_set_thread(unsigned int thread);
+
+extern void lockstat_lock(lockstat_t *ls, pthread_mutex_t *mutex);
+extern void lockstat_unlock(lockstat_t *ls, pthread_mutex_t *mutex);
+
+/*
+ * lockstat_cond_wait() waits on cond with mutex held through lockstat_lock().
+ * The time blocked is not hold time.  If contended is set, the condition is
+ * the lock being unavailable (the IRWL reader waiting out writers) and the
+ * time counts as wait time; otherwise it is an ordinary event wait and is
+ * not counted at all.
+ */
+extern void lockstat_cond_wait(lockstat_t *ls, pthread_cond_t *cond,
+    pthread_mutex_t *mutex, int contended);
+
+/* lockstat_print() prints the per-lock and per-thread tables. */
+extern void lockstat_print(void);
+
+
+#endif /* __LOCKSTAT_H__ */
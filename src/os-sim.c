@@ -8,12 +8,18 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <ucontext.h>
 
+#include "eventcount.h"
+#include "lockstat.h"
 #include "os-sim.h"
 #include "process.h"
 #include "student.h"
@@ -27,12 +33,25 @@ typedef enum {
     CPU_TERMINATE
 } simulator_cpu_state_t;
 
+/*
+ * The supervisor writes a CPU's entry and that CPU's thread reads it, so
+ * each entry gets its own cache lines.  state is also read without
+ * simulator_mutex: by a CPU thread waiting on event for it to leave
+ * CPU_RUNNING, and by simulator_cpu_wait() waiting on done for it to
+ * return to CPU_RUNNING or CPU_IDLE.
+ */
 typedef struct {
     pcb_t *current;
     simulator_cpu_state_t state;
-    pthread_cond_t wakeup;
+    eventcount_t event;             /* state left CPU_RUNNING */
+    eventcount_t done;              /* the CPU thread is back in its loop */
+    int batched;                    /* the event is part of a SIM_PARALLEL batch */
     int preemption_timer;
-} simulator_cpu_data_t;
+    pthread_mutex_t idle_mutex;     /* idle_wait() and idle_kick() */
+    pthread_cond_t idle_wakeup;
+    int kicked;
+    int parked;                     /* in idle_wait() with no kick pending */
+} __attribute__((aligned(64))) simulator_cpu_data_t;
 
 /* The I/O queue is a simple, FIFO queue using a linked list */
 typedef struct _io_request {
@@ -46,25 +65,140 @@ static io_request *io_queue_head = NULL, *io_queue_tail = NULL;
 static simulator_cpu_data_t *simulator_cpu_data;
 static pthread_t *cpu_thread;
 static pthread_mutex_t simulator_mutex;
+static lockstat_t simulator_lockstat;
 static unsigned int simulator_time = 0;
 static unsigned int processes_terminated = 0;
 static unsigned int cpu_count;
 static unsigned int ready_counter = 0, running_counter = 0, waiting_counter = 0;
 static unsigned int context_switches = 0;
+static unsigned int processes_created = 0;
+static unsigned int simulator_flags = 0;
+
+/* SIM_INLINE: a handler ran, so an idle CPU may now find work */
+static int idle_poll_pending = 0;
+
+/* Wall-clock time the simulation started, for the ticks/s figure */
+static struct timespec simulator_started;
+
+/*
+ * busy_cpus has bit n set while CPU n has a process, so the per-tick loops
+ * visit only those (never more than PROCESS_COUNT) however many CPUs there
+ * are.  It only changes in context_switch(), under simulator_mutex.
+ */
+#define CPU_WORD_BITS (8 * sizeof(unsigned long))
+static unsigned long *busy_cpus;
+static unsigned int busy_words, nr_busy = 0;
+
+/*
+ * waking_cpus has bit n set while idle CPU n may not have settled (see
+ * simulator_settled()): it has not yet been seen parked since it started,
+ * went idle in context_switch() or was kicked.  It is only changed
+ * atomically, since idle_kick() may run on any thread.
+ */
+static unsigned long *waking_cpus;
+
+/* Stack for each CPU thread; the student's handlers do not go deep */
+#define CPU_THREAD_STACK (256 * 1024)
+
+/* CPUs beyond this are left out of the Gantt chart's per-CPU columns */
+#define GANTT_CPU_COLUMNS 16
+
+/*
+ * Coroutine CPUs (SIM_COROUTINES).  Each CPU runs simulator_cpu_coroutine()
+ * on a stack of its own, all on the supervisor thread.  A coroutine runs
+ * until it waits for its next event or in idle_wait(), and control then
+ * goes back to whoever resumed it.  pending_cpus has a bit set for each
+ * CPU kicked while in idle_wait(), for simulate_idle_cpus() to resume.
+ */
+#define COROUTINE_STACK (64 * 1024)
+
+typedef struct {
+    ucontext_t context;
+    ucontext_t *resumer;
+    void *stack;
+    int idle_waiting;
+} simulator_coroutine_t;
+
+static simulator_coroutine_t *coroutines;
+static ucontext_t supervisor_context;
+static int running_coroutine = -1;
+static unsigned long *pending_cpus;
+
+/*
+ * Parallel dispatch (SIM_PARALLEL).  batch_pending counts the CPUs given an
+ * event by simulate_cpus_parallel() whose handlers have not yet finished;
+ * the CPU thread that brings it to zero signals batch_done.  It only
+ * changes under simulator_mutex.
+ */
+static unsigned int batch_pending = 0;
+static eventcount_t batch_done;
+
+/* CPU-ticks spent idle while at least one process was READY */
+static unsigned int idle_while_ready = 0;
+
+/*
+ * Processes that became ready this tick, from I/O completion or creation.
+ * simulate_wake_ups() hands them to the scheduler in a single call.
+ */
+static pcb_t *wake_batch[PROCESS_COUNT];
+static unsigned int wake_batch_size = 0;
+
+/* Dispatches of a process that last ran on another CPU, or on the same one */
+static unsigned int migrations = 0, same_cpu_dispatches = 0;
+
+/*
+ * READY spells.  ready_streak[n] counts the consecutive ticks process n has
+ * been READY; when it leaves READY the spell is appended to ready_spells[n]
+ * so print_final_stats() can report the longest and 99th percentile wait
+ * per priority.  Only the supervisor thread touches them.
+ */
+typedef struct {
+    unsigned int *ticks;
+    unsigned int count;
+    unsigned int capacity;
+} spell_list;
+static unsigned int ready_streak[PROCESS_COUNT];
+static spell_list ready_spells[PROCESS_COUNT];
+
+/* Wall-clock time spent in one kind of supervisor work, with -c */
+typedef struct {
+    unsigned long count;
+    unsigned long total_ns;
+    unsigned long max_ns;
+} simulator_timing_t;
 
 static void simulator_supervisor_thread(void);
 static void simulator_cpu_thread(unsigned int cpu_id);
+static void simulator_call_student(unsigned int cpu_id, simulator_cpu_state_t state);
+static void simulator_cpu_event(unsigned int cpu_id, simulator_cpu_state_t state);
+static void simulator_cpu_post(unsigned int cpu_id, simulator_cpu_state_t state);
+static void simulator_cpu_wait(simulator_cpu_data_t *cpu);
+static void simulate_idle_cpus(void);
+static void simulator_cpu_coroutine(void);
+static void coroutine_resume(unsigned int cpu_id);
+static void coroutine_block(void);
+static int next_cpu(const unsigned long *mask, unsigned int cpu_id);
 
 int nanosleep(const struct timespec *rqtp, struct timespec *rmtp);
 
 static void print_gantt_header(void);
 static void print_gantt_line(void);static void print_final_stats(void);
+static void simulator_timing_add(simulator_timing_t *timing, const struct timespec *start);
+static void simulator_timing_print(const char *name, const simulator_timing_t *timing);
 
 static void simulate_cpus(void);
-static void simulate_process(unsigned int cpu_id, pcb_t *pcb);
+static void simulate_cpus_parallel(void);
+static simulator_cpu_state_t simulate_process(unsigned int cpu_id, pcb_t *pcb);
 static void submit_io_request(pcb_t *pcb, unsigned int execution_time);
 static void simulate_io(void);
 static void simulate_creat(void);
+static void simulate_wake_ups(void);
+static int simulator_cpu_settled(unsigned int cpu_id);
+static int simulator_unsettled_cpu(void);
+static int simulator_settled(void);
+static void simulator_settle(void);
+static unsigned int simulator_quiet_ticks(void);
+static void simulate_quiet_ticks(unsigned int ticks);
 
 static void* simulator_cpu_thread_func(void *data);
 
@@ -84,53 +218,109 @@ static void* simulator_cpu_thread_func(void *data);
  *
  * For the student_lock, the IRWL_WRITER should always be locked while
  * student code is executing on a CPU thread.  The IRWL_READER should always be
- * locked whenever non-constant data in a PCB is used by the library.
+ * locked whenever non-constant data in a PCB is used by the library, except
+ * for the states, which print_gantt_line() reads through gantt_snapshot()
+ * without waiting for the student's code.
  * j
  */
 typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t no_writers;
     int writers;
+    lockstat_t reader_stats;
+    lockstat_t writer_stats;
 } irwl;
 
-#define IRWL_INIT(i) \
+/*
+ * With lock statistics on, a reader's wait includes waiting out the
+ * writers, and a writer's hold runs from WRITER_LOCK to WRITER_UNLOCK even
+ * though the mutex itself is only held briefly at each end.
+ */
+#define IRWL_INIT(i, name) \
     pthread_mutex_init(&(i).mutex, NULL); \
     pthread_cond_init(&(i).no_writers, NULL); \
-    (i).writers = 0;
+    (i).writers = 0; \
+    lockstat_register(&(i).reader_stats, name "/read", -1); \
+    lockstat_register(&(i).writer_stats, name "/write", -1);
 
 #define IRWL_READER_LOCK(i) \
-    pthread_mutex_lock(&(i).mutex); \
+    lockstat_lock(&(i).reader_stats, &(i).mutex); \
     while ((i).writers > 0) \
-    { pthread_cond_wait(&(i).no_writers, &(i).mutex); }
+    { lockstat_cond_wait(&(i).reader_stats, &(i).no_writers, &(i).mutex, 1); }
 
 #define IRWL_READER_UNLOCK(i) \
-    pthread_mutex_unlock(&(i).mutex);
+    lockstat_unlock(&(i).reader_stats, &(i).mutex);
 
 #define IRWL_WRITER_LOCK(i) \
-    pthread_mutex_lock(&(i).mutex); \
-    (i).writers++; \
+    lockstat_lock(&(i).writer_stats, &(i).mutex); \
+    __atomic_add_fetch(&(i).writers, 1, __ATOMIC_SEQ_CST); \
     pthread_mutex_unlock(&(i).mutex);
 
 #define IRWL_WRITER_UNLOCK(i) \
     pthread_mutex_lock(&(i).mutex); \
-    (i).writers--; \
+    __atomic_sub_fetch(&(i).writers, 1, __ATOMIC_SEQ_CST); \
     if ((i).writers == 0) \
     { pthread_cond_signal(&(i).no_writers); } \
-    pthread_mutex_unlock(&(i).mutex);
+    lockstat_unlock(&(i).writer_stats, &(i).mutex);
+
+/* simulator_mutex is taken through these so -c can account for it */
+#define SIMULATOR_LOCK() lockstat_lock(&simulator_lockstat, &simulator_mutex)
+#define SIMULATOR_UNLOCK() lockstat_unlock(&simulator_lockstat, &simulator_mutex)
 
 static irwl student_lock;
 
+/*
+ * The Gantt chart reads the PCB states as in a seqlock.  Each store of a
+ * state goes through set_process_state(), which counts itself in
+ * state_writers for the length of the store and moves state_seq after it.
+ * gantt_snapshot() keeps its copy of the states only if no store was in
+ * progress before or after it copied and state_seq did not move in
+ * between, and otherwise copies again.  A store takes a few instructions,
+ * so it only retries when one actually overlapped the copy.  Every
+ * GANTT_SNAPSHOT_SPINS retries it yields, in case the thread storing was
+ * preempted in the middle.
+ */
+#define GANTT_SNAPSHOT_SPINS 64
+static unsigned int state_writers = 0, state_seq = 0;
+static process_state_t gantt_states[PROCESS_COUNT];
+
+/*
+ * With lock statistics on (-c), the supervisor also times each pass of its
+ * loop, from taking simulator_mutex to letting it go (so not the sleep or
+ * settle that follows; with SIM_EVENT_DRIVEN one pass may cover several
+ * quiet ticks), and each Gantt line, and counts the snapshot's retries.
+ */
+static simulator_timing_t tick_timing, gantt_timing;
+static unsigned long gantt_retries = 0;
+
+
+extern void set_simulator_flags(unsigned int flags)
+{
+    simulator_flags = flags;
+}
+
 
 /* The big initialization function */
 extern void start_simulator(unsigned int new_cpu_count)
 {
+    pthread_attr_t attr;
     unsigned int n;
 
     /* Make sure the # of CPUs is reasonable */
     cpu_count = new_cpu_count;
-    if (cpu_count < 1 || cpu_count > 16)
+    if (cpu_count < 1 || cpu_count > SIM_MAX_CPUS)
     {
-        fprintf(stderr, "CPU Count must be an integer from 1 to 16!\n\n");
+        fprintf(stderr, "CPU Count must be an integer from 1 to %d!\n\n", SIM_MAX_CPUS);
+        exit(-1);
+    }
+    if ((simulator_flags & SIM_INLINE) && (simulator_flags & SIM_COROUTINES))
+    {
+        fprintf(stderr, "Inline and coroutine CPUs cannot be combined!\n\n");
+        exit(-1);
+    }
+    if ((simulator_flags & SIM_PARALLEL) && (simulator_flags & (SIM_INLINE | SIM_COROUTINES)))
+    {
+        fprintf(stderr, "Parallel dispatch needs CPU threads!\n\n");
         exit(-1);
     }
 
@@ -138,26 +328,68 @@ extern void start_simulator(unsigned int new_cpu_count)
     /* Allocate arrays */
     cpu_thread = malloc(sizeof(pthread_t) * cpu_count);
     assert(cpu_thread != NULL);
-    simulator_cpu_data = malloc(sizeof(simulator_cpu_data_t) * cpu_count);
-    assert(simulator_cpu_data != NULL);
+    if (posix_memalign((void **)&simulator_cpu_data, 64,
+        sizeof(simulator_cpu_data_t) * cpu_count) != 0)
+        assert(0);
+    busy_words = (cpu_count + (unsigned int)CPU_WORD_BITS - 1) / (unsigned int)CPU_WORD_BITS;
+    busy_cpus = calloc(busy_words, sizeof(unsigned long));
+    waking_cpus = calloc(busy_words, sizeof(unsigned long));
+    assert(busy_cpus != NULL && waking_cpus != NULL);
 
     /* Initialize mutexes and condition variables */
     pthread_mutex_init(&simulator_mutex, NULL);
+    lockstat_register(&simulator_lockstat, "simulator_mutex", -1);
     simulator_time = 0;
     for (n=0; n<cpu_count; n++)
     {
         simulator_cpu_data[n].current = NULL;
         simulator_cpu_data[n].state = CPU_IDLE;
         simulator_cpu_data[n].preemption_timer = -1;
-        pthread_cond_init(&simulator_cpu_data[n].wakeup, NULL);
+        eventcount_init(&simulator_cpu_data[n].event);
+        eventcount_init(&simulator_cpu_data[n].done);
+        simulator_cpu_data[n].batched = 0;
+        pthread_mutex_init(&simulator_cpu_data[n].idle_mutex, NULL);
+        pthread_cond_init(&simulator_cpu_data[n].idle_wakeup, NULL);
+        simulator_cpu_data[n].kicked = 0;
+        simulator_cpu_data[n].parked = 0;
+        waking_cpus[n / CPU_WORD_BITS] |= 1ul << (n % CPU_WORD_BITS);
     }
 
-    IRWL_INIT(student_lock)
+    eventcount_init(&batch_done);
+    IRWL_INIT(student_lock, "student_lock")
 
-    /* Start CPU threads */
-    for (n=0; n<cpu_count; n++)
-        pthread_create(&cpu_thread[n], NULL, simulator_cpu_thread_func,
-        (void*)(uintptr_t)n);
+    clock_gettime(CLOCK_MONOTONIC, &simulator_started);
+
+    /* Start CPU threads, unless the supervisor runs the student's code itself */
+    if (simulator_flags & SIM_COROUTINES)
+    {
+        coroutines = calloc(cpu_count, sizeof(simulator_coroutine_t));
+        pending_cpus = calloc(busy_words, sizeof(unsigned long));
+        assert(coroutines != NULL && pending_cpus != NULL);
+        for (n=0; n<cpu_count; n++)
+        {
+            coroutines[n].stack = malloc(COROUTINE_STACK);
+            assert(coroutines[n].stack != NULL);
+            getcontext(&coroutines[n].context);
+            coroutines[n].context.uc_stack.ss_sp = coroutines[n].stack;
+            coroutines[n].context.uc_stack.ss_size = COROUTINE_STACK;
+            coroutines[n].context.uc_link = NULL;
+            makecontext(&coroutines[n].context, simulator_cpu_coroutine, 0);
+        }
+
+        /* Run each CPU until it first waits, as its thread would */
+        for (n=0; n<cpu_count; n++)
+            coroutine_resume(n);
+    }
+    else if (!(simulator_flags & SIM_INLINE))
+    {
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, CPU_THREAD_STACK);
+        for (n=0; n<cpu_count; n++)
+            pthread_create(&cpu_thread[n], &attr, simulator_cpu_thread_func,
+            (void*)(uintptr_t)n);
+        pthread_attr_destroy(&attr);
+    }
 
     /* Start supervisor thread */
     simulator_supervisor_thread();
@@ -171,13 +403,17 @@ extern void start_simulator(unsigned int new_cpu_count)
  */
 static void simulator_supervisor_thread(void)
 {
+    struct timespec tick_start;
+
     print_gantt_header();
 
     /* Loop, performing execution every 100ms.  At each execution, we will
        display a line in the Gantt chart and check for pending I/O requests */
     while (1)
     {
-        pthread_mutex_lock(&simulator_mutex);
+        if (lockstat_enabled)
+            clock_gettime(CLOCK_MONOTONIC, &tick_start);
+        SIMULATOR_LOCK();
 
         /* Exit when all processes terminate */
         if (processes_terminated >= PROCESS_COUNT)
@@ -186,14 +422,28 @@ static void simulator_supervisor_thread(void)
             exit(0);
         }
 
+        if (simulator_flags & SIM_EVENT_DRIVEN)
+            simulate_quiet_ticks(simulator_quiet_ticks());
+
         print_gantt_line();
-        simulate_cpus();
+        if (simulator_flags & SIM_PARALLEL)
+            simulate_cpus_parallel();
+        else
+            simulate_cpus();
         simulate_io();
         simulate_creat();
-        simulator_time++;
-        pthread_mutex_unlock(&simulator_mutex);
-
-        mt_safe_usleep(1);
+        simulate_wake_ups();
+        __atomic_store_n(&simulator_time, simulator_time + 1, __ATOMIC_RELEASE);
+        SIMULATOR_UNLOCK();
+        if (lockstat_enabled)
+            simulator_timing_add(&tick_timing, &tick_start);
+
+        if (simulator_flags & (SIM_INLINE | SIM_COROUTINES))
+            continue;
+        else if (simulator_flags & SIM_UNTHROTTLED)
+            simulator_settle();
+        else
+            mt_safe_usleep(1);
     }
 }
 
@@ -204,19 +454,20 @@ static void simulator_supervisor_thread(void)
  *   1) Each CPU thread has a state variable.  While the library is using the
  *      CPU thread to simulate a process, this variable is set to CPU_RUNNING.
  *
- *   2) To "simulate" a process, we simply block on a condition variable.
- *      Each CPU thread has a dedicated condition variable.
+ *   2) To "simulate" a process, we simply wait for the state variable to
+ *      change.  Each CPU thread has a dedicated eventcount, event.
  *
  *   3) For simplicity, the supervisor thread actually does all of the work.
  *      This makes synchronization in the simulator much easier, since all
  *      the real work is done by a single thread.  So, when the supervisor
  *      wants to dispatch an event to a CPU thread, it needs to unblock the
  *      CPU thread.  It does this by setting the CPU thread's state variable
- *      to inform the CPU thread of the event, then it signals the condition
- *      variable.
+ *      to inform the CPU thread of the event, then it signals the event
+ *      eventcount.
  *
  *   4) Once the CPU thread unblocks, it calls the students event handler,
- *      then goes back to step 1.
+ *      then goes back to step 1, and signals its done eventcount to let the
+ *      supervisor carry on.
  *
  * There is one special case: idle.  Idle is simulated by the student's code,
  * not the library's.  So we simply set the state variable to CPU_IDLE, and
@@ -224,68 +475,189 @@ static void simulator_supervisor_thread(void)
  */
 static void simulator_cpu_thread(unsigned int cpu_id)
 {
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
     simulator_cpu_state_t state;
+    unsigned int key;
+    int batch_finished;
 
     while (1)
     {
-        pthread_mutex_lock(&simulator_mutex);
-
-        /* Let the simulator know the scheduler has been run */
-        pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-
-        if (simulator_cpu_data[cpu_id].current == NULL)
+        SIMULATOR_LOCK();
+        if (cpu->current == NULL)
         {
             /* the idle process was selected */
-            simulator_cpu_data[cpu_id].state = CPU_IDLE;
+            state = CPU_IDLE;
         }
         else
         {
             /* a process was scheduled */
-            simulator_cpu_data[cpu_id].state = CPU_RUNNING;
-
-            while (simulator_cpu_data[cpu_id].state == CPU_RUNNING)
-                pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
-                    &simulator_mutex);
+            state = CPU_RUNNING;
         }
-        state = simulator_cpu_data[cpu_id].state;
-        pthread_mutex_unlock(&simulator_mutex);
+        __atomic_store_n(&cpu->state, state, __ATOMIC_RELEASE);
+        batch_finished = cpu->batched && __atomic_sub_fetch(&batch_pending, 1, __ATOMIC_RELEASE) == 0;
+        cpu->batched = 0;
+        SIMULATOR_UNLOCK();
+
+        /* Let the simulator know the scheduler has been run */
+        eventcount_signal(&cpu->done);
+        if (batch_finished)
+            eventcount_signal(&batch_done);
 
-        /* Call student's code */
-        switch (state)
+        while (state == CPU_RUNNING)
         {
-        case CPU_IDLE:
-            /*
-             * We can't lock the student_lock for idle(); otherwise we can't
-             * print statistics while any CPU is idling.
-             */
-            idle(cpu_id);
-            break;
+            key = eventcount_prepare(&cpu->event);
+            state = __atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE);
+            if (state == CPU_RUNNING)
+                eventcount_wait(&cpu->event, key);
+        }
 
-        case CPU_PREEMPT:
-            IRWL_WRITER_LOCK(student_lock)
-            preempt(cpu_id);
-            IRWL_WRITER_UNLOCK(student_lock)
-            break;
+        simulator_call_student(cpu_id, state);
+    }
+}
 
-        case CPU_YIELD:
-            IRWL_WRITER_LOCK(student_lock)
-            yield(cpu_id);
-            IRWL_WRITER_UNLOCK(student_lock)
-            break;
+/* Calls the student's handler for state; simulator_mutex must not be held */
+static void simulator_call_student(unsigned int cpu_id, simulator_cpu_state_t state)
+{
+    switch (state)
+    {
+    case CPU_IDLE:
+        /*
+         * We can't lock the student_lock for idle(); otherwise we can't
+         * print statistics while any CPU is idling.
+         */
+        idle(cpu_id);
+        break;
 
-        case CPU_TERMINATE:
-            pthread_mutex_lock(&simulator_mutex);
-            processes_terminated++;
-            pthread_mutex_unlock(&simulator_mutex);
-            IRWL_WRITER_LOCK(student_lock)
-            terminate(cpu_id);
-            IRWL_WRITER_UNLOCK(student_lock)
-            break;
+    case CPU_PREEMPT:
+        IRWL_WRITER_LOCK(student_lock)
+        preempt(cpu_id);
+        IRWL_WRITER_UNLOCK(student_lock)
+        break;
 
-        case CPU_RUNNING:
-            /* This should never happen!!! */
-            break;
+    case CPU_YIELD:
+        IRWL_WRITER_LOCK(student_lock)
+        yield(cpu_id);
+        IRWL_WRITER_UNLOCK(student_lock)
+        break;
+
+    case CPU_TERMINATE:
+        SIMULATOR_LOCK();
+        processes_terminated++;
+        SIMULATOR_UNLOCK();
+        IRWL_WRITER_LOCK(student_lock)
+        terminate(cpu_id);
+        IRWL_WRITER_UNLOCK(student_lock)
+        break;
+
+    case CPU_RUNNING:
+        /* This should never happen!!! */
+        break;
+    }
+}
+
+/*
+ * simulator_cpu_event() delivers a preempt, yield or terminate event to a
+ * CPU and returns once the student's handler has run.  It is called with
+ * simulator_mutex held, and releases it while the handler runs.
+ *
+ * Normally the CPU's thread runs the handler.  With SIM_COROUTINES the
+ * CPU's coroutine runs it, until it next waits.  With SIM_INLINE the caller
+ * runs it, and then does what the CPU thread would do next: mark the CPU
+ * running or idle.
+ */
+static void simulator_cpu_event(unsigned int cpu_id, simulator_cpu_state_t state)
+{
+    if (simulator_flags & SIM_COROUTINES)
+    {
+        simulator_cpu_data[cpu_id].state = state;
+        SIMULATOR_UNLOCK();
+        coroutine_resume(cpu_id);
+        SIMULATOR_LOCK();
+        return;
+    }
+
+    if (simulator_flags & SIM_INLINE)
+    {
+        simulator_cpu_data[cpu_id].state = state;
+        SIMULATOR_UNLOCK();
+        simulator_call_student(cpu_id, state);
+        SIMULATOR_LOCK();
+        simulator_cpu_data[cpu_id].state =
+            simulator_cpu_data[cpu_id].current != NULL ? CPU_RUNNING : CPU_IDLE;
+        idle_poll_pending = 1;
+        return;
+    }
+
+    /* Ensure the scheduler gets run before the simulator */
+    simulator_cpu_post(cpu_id, state);
+    SIMULATOR_UNLOCK();
+    simulator_cpu_wait(&simulator_cpu_data[cpu_id]);
+    SIMULATOR_LOCK();
+}
+
+/* simulator_cpu_post() wakes a CPU thread for an event, with simulator_mutex held */
+static void simulator_cpu_post(unsigned int cpu_id, simulator_cpu_state_t state)
+{
+    __atomic_store_n(&simulator_cpu_data[cpu_id].state, state, __ATOMIC_RELEASE);
+    eventcount_signal(&simulator_cpu_data[cpu_id].event);
+}
+
+/*
+ * simulator_cpu_wait() waits, without simulator_mutex, until the CPU's
+ * thread has handled the event in its state and is back in its loop.
+ */
+static void simulator_cpu_wait(simulator_cpu_data_t *cpu)
+{
+    simulator_cpu_state_t state;
+    unsigned int key;
+
+    while (1)
+    {
+        key = eventcount_prepare(&cpu->done);
+        state = __atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE);
+        if (state == CPU_RUNNING || state == CPU_IDLE)
+            return;
+        eventcount_wait(&cpu->done, key);
+    }
+}
+
+/*
+ * With SIM_INLINE, idle() returns instead of waiting when there is nothing
+ * to run, so the supervisor offers each idle CPU, in order, the chance to
+ * pick up work whenever some may have arrived, until none is READY.  With
+ * SIM_COROUTINES it resumes the CPUs that were kicked in idle_wait().
+ * Called with simulator_mutex held.
+ */
+static void simulate_idle_cpus(void)
+{
+    unsigned int n;
+    int cpu;
+
+    idle_poll_pending = 0;
+    if (simulator_flags & SIM_COROUTINES)
+    {
+        while ((cpu = next_cpu(pending_cpus, 0)) >= 0)
+        {
+            pending_cpus[cpu / (int)CPU_WORD_BITS] &= ~(1ul << (cpu % (int)CPU_WORD_BITS));
+            SIMULATOR_UNLOCK();
+            coroutine_resume((unsigned int)cpu);
+            SIMULATOR_LOCK();
         }
+        return;
+    }
+
+    for (n=0; n<cpu_count; n++)
+    {
+        if (simulator_cpu_data[n].current != NULL)
+            continue;
+        /* Once nothing is READY, no other idle CPU can find work either */
+        if (processes_ready() == 0)
+            break;
+        SIMULATOR_UNLOCK();
+        idle(n);
+        SIMULATOR_LOCK();
+        if (simulator_cpu_data[n].current != NULL)
+            simulator_cpu_data[n].state = CPU_RUNNING;
     }
 }
 
@@ -300,29 +672,86 @@ static void print_gantt_header(void)
     unsigned int n;
 
     printf("Time  Ru Re Wa     ");
-    for (n=0; n<cpu_count; n++)
-        printf(" CPU %d   ", n);
+    if (cpu_count > GANTT_CPU_COLUMNS)
+        printf(" Busy CPUs (cpu:process)");
+    else
+    {
+        for (n=0; n<cpu_count; n++)
+            printf(" CPU %d   ", n);
+    }
     printf("     < I/O Queue <\n"
            "===== == == ==     ");
-    for (n=0; n<cpu_count; n++)
-        printf(" ========");
+    if (cpu_count > GANTT_CPU_COLUMNS)
+        printf(" ========================");
+    else
+    {
+        for (n=0; n<cpu_count; n++)
+            printf(" ========");
+    }
     printf("     =============\n");
 }
 
+static void record_ready_spell(unsigned int pid)
+{
+    spell_list *list = &ready_spells[pid];
+
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->ticks = realloc(list->ticks, sizeof(unsigned int) * list->capacity);
+        assert(list->ticks != NULL);
+    }
+    list->ticks[list->count++] = ready_streak[pid];
+    ready_streak[pid] = 0;
+}
+
+/* gantt_snapshot() returns a consistent copy of every process's state */
+static const process_state_t *gantt_snapshot(void)
+{
+    unsigned int tries, seq, n;
+
+    for (tries=0; ; tries++)
+    {
+        if (tries > 0)
+        {
+            gantt_retries++;
+            if (tries % GANTT_SNAPSHOT_SPINS == 0)
+                sched_yield();
+            else
+                cpu_relax();
+        }
+        seq = __atomic_load_n(&state_seq, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&state_writers, __ATOMIC_SEQ_CST) > 0)
+            continue;
+        for (n=0; n<PROCESS_COUNT; n++)
+            gantt_states[n] = __atomic_load_n(&processes[n].state, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&state_writers, __ATOMIC_SEQ_CST) == 0
+            && __atomic_load_n(&state_seq, __ATOMIC_SEQ_CST) == seq)
+            return gantt_states;
+    }
+}
+
 static void print_gantt_line(void)
 {
+    const process_state_t *states;
+    struct timespec start;
     io_request *r;
     unsigned int current_ready = 0, current_running = 0, current_waiting = 0;
     unsigned int n;
+    int cpu;
+
+    if (lockstat_enabled)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    states = gantt_snapshot();
 
 
     /*
      * Update number of processes in each state.
      */
-    IRWL_READER_LOCK(student_lock)
     for (n=0; n<PROCESS_COUNT; n++)
     {
-        switch(processes[n].state)
+        switch(states[n])
         {
         case PROCESS_READY:
             current_ready++;
@@ -342,21 +771,36 @@ static void print_gantt_line(void)
         default:
             break;
         }
+
+        if (states[n] == PROCESS_READY)
+            ready_streak[n]++;
+        else if (ready_streak[n] > 0)
+            record_ready_spell(n);
     }
-    IRWL_READER_UNLOCK(student_lock)
+
+    if (current_ready > 0)
+        idle_while_ready += cpu_count - nr_busy;
 
 
     /* Print time */
     printf("%-5.1f %-2d %-2d %-2d     ", (float)simulator_time / 10.0,
         current_running, current_ready, current_waiting);
 
-    /* Print running processes */
-    for (n=0; n<cpu_count; n++)
+    /* Print running processes; with many CPUs, only the busy ones */
+    if (cpu_count > GANTT_CPU_COLUMNS)
     {
-        if (simulator_cpu_data[n].current != NULL)
-            printf(" %-8s", simulator_cpu_data[n].current->name);
-        else
-            printf(" (IDLE)  ");
+        for (cpu = next_cpu(busy_cpus, 0); cpu >= 0; cpu = next_cpu(busy_cpus, (unsigned int)cpu + 1))
+            printf(" %d:%s", cpu, simulator_cpu_data[cpu].current->name);
+    }
+    else
+    {
+        for (n=0; n<cpu_count; n++)
+        {
+            if (simulator_cpu_data[n].current != NULL)
+                printf(" %-8s", simulator_cpu_data[n].current->name);
+            else
+                printf(" (IDLE)  ");
+        }
     }
 
     /* Print I/O requests */
@@ -368,25 +812,127 @@ static void print_gantt_line(void)
         r = r->next;
     }
     printf(" <\n");
+
+    if (lockstat_enabled)
+        simulator_timing_add(&gantt_timing, &start);
+}
+
+static void simulator_timing_add(simulator_timing_t *timing, const struct timespec *start)
+{
+    struct timespec now;
+    unsigned long ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ns = (unsigned long)((now.tv_sec - start->tv_sec) * 1000000000l
+        + (now.tv_nsec - start->tv_nsec));
+    timing->count++;
+    timing->total_ns += ns;
+    if (ns > timing->max_ns)
+        timing->max_ns = ns;
+}
+
+static void simulator_timing_print(const char *name, const simulator_timing_t *timing)
+{
+    printf("%s: %.1f us average, %.1f us max over %lu\n", name,
+        timing->count > 0 ? (double)timing->total_ns / (double)timing->count / 1000.0 : 0.0,
+        (double)timing->max_ns / 1000.0, timing->count);
+}
+
+static int compare_ticks(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *)a, y = *(const unsigned int *)b;
+    return (x > y) - (x < y);
+}
+
+/* Prints the longest and 99th percentile READY spell for each priority */
+static void print_ready_spells(void)
+{
+    unsigned int n, m, count, done[PROCESS_COUNT] = { 0 };
+    unsigned int *ticks;
+
+    printf("READY time by priority:\n");
+    printf("  %-8s %8s %8s %8s\n", "priority", "spells", "max (s)", "p99 (s)");
+    for (;;)
+    {
+        /* Take the best priority not reported yet */
+        n = PROCESS_COUNT;
+        for (m=0; m<PROCESS_COUNT; m++)
+        {
+            if (!done[m] && (n == PROCESS_COUNT || processes[m].priority < processes[n].priority))
+                n = m;
+        }
+        if (n == PROCESS_COUNT)
+            break;
+
+        /* Gather the spells of every process with this priority */
+        count = 0;
+        for (m=n; m<PROCESS_COUNT; m++)
+        {
+            if (processes[m].priority == processes[n].priority)
+                count += ready_spells[m].count;
+        }
+        ticks = malloc(sizeof(unsigned int) * (count ? count : 1));
+        assert(ticks != NULL);
+        count = 0;
+        for (m=n; m<PROCESS_COUNT; m++)
+        {
+            if (processes[m].priority != processes[n].priority)
+                continue;
+            done[m] = 1;
+            memcpy(ticks + count, ready_spells[m].ticks,
+                sizeof(unsigned int) * ready_spells[m].count);
+            count += ready_spells[m].count;
+        }
+
+        qsort(ticks, count, sizeof(unsigned int), compare_ticks);
+        if (count > 0)
+            printf("  %-8d %8u %8.1f %8.1f\n", processes[n].priority, count,
+                (float)ticks[count - 1] / 10.0,
+                (float)ticks[(count * 99 + 99) / 100 - 1] / 10.0);
+        else
+            printf("  %-8d %8u %8s %8s\n", processes[n].priority, count, "-", "-");
+        free(ticks);
+    }
 }
 
 static void print_final_stats(void)
 {
+    struct timespec now;
+    double wall;
+
     printf("\n\n");
     printf("# of Context Switches: %u\n", context_switches);
     printf("Total execution time: %.1f s\n", (float)simulator_time / 10.0);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    wall = (double)(now.tv_sec - simulator_started.tv_sec)
+        + (double)(now.tv_nsec - simulator_started.tv_nsec) / 1e9;
+    fprintf(stderr, "Simulation speed: %u ticks in %.3f s wall time (%.0f ticks/s)\n",
+        simulator_time, wall, wall > 0 ? simulator_time / wall : 0.0);
     printf("Total time spent in READY state: %.1f s\n", (float)ready_counter / 10.0);
+    printf("CPU time idle while processes were READY: %.1f s\n", (float)idle_while_ready / 10.0);
+    print_ready_spells();
+    printf("Migrations: %u, same-CPU dispatches: %u (%.1f%% of re-dispatches)\n",
+        migrations, same_cpu_dispatches,
+        migrations + same_cpu_dispatches > 0
+            ? 100.0 * same_cpu_dispatches / (migrations + same_cpu_dispatches) : 0.0);
+    print_scheduler_stats();
+    lockstat_print();
+    if (lockstat_enabled)
+    {
+        simulator_timing_print("Supervisor time per pass", &tick_timing);
+        simulator_timing_print("Gantt line", &gantt_timing);
+        printf("Gantt snapshot retries: %lu\n", gantt_retries);
+    }
 }
 
 
 
 /*
- * context_switch() and force_preempt() are the two functions available to
- * student's code.
+ * context_switch(), force_preempt(), set_process_state() and
+ * get_simulator_time() are the functions available to student's code.
  */
-extern void context_switch(unsigned int cpu_id, pcb_t *pcb)
+extern void context_switch(unsigned int cpu_id, pcb_t *pcb, int preemption_time)
 {
-    int preemption_time = -1;
     assert(cpu_id < cpu_count);
     assert(pcb == NULL || (pcb >= processes && pcb <= processes +
         PROCESS_COUNT - 1));
@@ -394,19 +940,58 @@ extern void context_switch(unsigned int cpu_id, pcb_t *pcb)
     context_switches++;
 
     IRWL_WRITER_UNLOCK(student_lock);
-    pthread_mutex_lock(&simulator_mutex);
+    SIMULATOR_LOCK();
+    if ((simulator_cpu_data[cpu_id].current != NULL) != (pcb != NULL))
+    {
+        busy_cpus[cpu_id / CPU_WORD_BITS] ^= 1ul << (cpu_id % CPU_WORD_BITS);
+        nr_busy += pcb != NULL ? 1 : (unsigned int)-1;
+    }
     simulator_cpu_data[cpu_id].current = pcb;
     simulator_cpu_data[cpu_id].preemption_timer = preemption_time;
-    pthread_mutex_unlock(&simulator_mutex);
+    if (pcb == NULL)
+        __atomic_or_fetch(&waking_cpus[cpu_id / CPU_WORD_BITS],
+            1ul << (cpu_id % CPU_WORD_BITS), __ATOMIC_SEQ_CST);
+    else
+    {
+        if (pcb->last_cpu == (int)cpu_id)
+            same_cpu_dispatches++;
+        else if (pcb->last_cpu >= 0)
+            migrations++;
+        __atomic_store_n(&pcb->last_cpu, (int)cpu_id, __ATOMIC_RELAXED);
+    }
+    SIMULATOR_UNLOCK();
     IRWL_WRITER_LOCK(student_lock);
 }
 
-extern void force_preempt(unsigned int cpu_id)
+extern void set_process_state(pcb_t *pcb, process_state_t state)
+{
+    assert(pcb >= processes && pcb <= processes + PROCESS_COUNT - 1);
+
+    /* See gantt_snapshot() */
+    __atomic_add_fetch(&state_writers, 1, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&pcb->state, state, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&state_seq, 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&state_writers, 1, __ATOMIC_SEQ_CST);
+}
+
+extern unsigned int get_simulator_time(void)
+{
+    /*
+     * Only the supervisor advances the clock, so a single atomic load is
+     * enough; taking simulator_mutex here could deadlock against
+     * print_gantt_line() the same way context_switch() has to avoid.
+     */
+    return __atomic_load_n(&simulator_time, __ATOMIC_ACQUIRE);
+}
+
+extern int force_preempt(unsigned int cpu_id)
 {
+    int preempted = 0;
+
     assert(cpu_id < cpu_count);
 
     IRWL_WRITER_UNLOCK(student_lock);
-    pthread_mutex_lock(&simulator_mutex);
+    SIMULATOR_LOCK();
 
     /*
      * It is possible that the student's code calls force_preempt() at the
@@ -415,16 +1000,13 @@ extern void force_preempt(unsigned int cpu_id)
      */
     if (simulator_cpu_data[cpu_id].state == CPU_RUNNING)
     {
-        simulator_cpu_data[cpu_id].state = CPU_PREEMPT;
-        pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-
-        /* Ensure the scheduler gets run before the simulator */
-        pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
-            &simulator_mutex);
+        simulator_cpu_event(cpu_id, CPU_PREEMPT);
+        preempted = 1;
     }
 
-    pthread_mutex_unlock(&simulator_mutex);
+    SIMULATOR_UNLOCK();
     IRWL_WRITER_LOCK(student_lock);
+    return preempted;
 }
 
 
@@ -434,6 +1016,8 @@ extern void force_preempt(unsigned int cpu_id)
  *
  * simulate_cpus() / simulate_process() simulate the processes on each CPU
  *   and signal the appropriate CPU thread if an event occurs.
+ *   simulate_process() returns the event, or CPU_RUNNING for none, and
+ *   simulate_cpus() or simulate_cpus_parallel() delivers it.
  *
  * submit_io_request() inserts a PCB into tail of the I/O queue.
  *
@@ -446,16 +1030,76 @@ extern void force_preempt(unsigned int cpu_id)
 
 static void simulate_cpus(void)
 {
-    unsigned int n;
+    simulator_cpu_state_t state;
+    int n;
 
-    for (n=0; n<cpu_count; n++)
+    /* A handler may start or stop other CPUs, so look again after each one */
+    for (n = next_cpu(busy_cpus, 0); n >= 0; n = next_cpu(busy_cpus, (unsigned int)n + 1))
     {
-        if (simulator_cpu_data[n].current != NULL)
-            simulate_process(n, simulator_cpu_data[n].current);
+        state = simulate_process((unsigned int)n, simulator_cpu_data[n].current);
+        if (state != CPU_RUNNING)
+            simulator_cpu_event((unsigned int)n, state);
+        if (idle_poll_pending)
+            simulate_idle_cpus();
+    }
+}
+
+/*
+ * simulate_cpus_parallel() is simulate_cpus() for SIM_PARALLEL.  Every
+ * handler needs simulator_mutex before it can touch the simulator, so
+ * posting each event during the scan lets none of them disturb it; the
+ * whole batch is released when the mutex is, and the supervisor then waits
+ * once for all of them.
+ */
+static void simulate_cpus_parallel(void)
+{
+    simulator_cpu_state_t state;
+    unsigned int key;
+    int n;
+
+    for (n = next_cpu(busy_cpus, 0); n >= 0; n = next_cpu(busy_cpus, (unsigned int)n + 1))
+    {
+        state = simulate_process((unsigned int)n, simulator_cpu_data[n].current);
+        if (state == CPU_RUNNING)
+            continue;
+        simulator_cpu_data[n].batched = 1;
+        __atomic_add_fetch(&batch_pending, 1, __ATOMIC_RELAXED);
+        simulator_cpu_post((unsigned int)n, state);
+    }
+
+    if (batch_pending == 0)
+        return;
+
+    SIMULATOR_UNLOCK();
+    while (1)
+    {
+        key = eventcount_prepare(&batch_done);
+        if (__atomic_load_n(&batch_pending, __ATOMIC_ACQUIRE) == 0)
+            break;
+        eventcount_wait(&batch_done, key);
     }
+    SIMULATOR_LOCK();
 }
 
-static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
+/* next_cpu() returns the first CPU from cpu_id on whose bit is set in mask, or -1 */
+static int next_cpu(const unsigned long *mask, unsigned int cpu_id)
+{
+    unsigned int word = cpu_id / (unsigned int)CPU_WORD_BITS;
+    unsigned long bits;
+
+    if (word >= busy_words)
+        return -1;
+    bits = mask[word] & (~0ul << (cpu_id % CPU_WORD_BITS));
+    while (bits == 0)
+    {
+        if (++word >= busy_words)
+            return -1;
+        bits = mask[word];
+    }
+    return (int)(word * CPU_WORD_BITS) + __builtin_ctzl(bits);
+}
+
+static simulator_cpu_state_t simulate_process(unsigned int cpu_id, pcb_t *pcb)
 {
     /*
      * The "program counter" is really just a pointer to the current position
@@ -479,12 +1123,7 @@ static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
             if (simulator_cpu_data[cpu_id].preemption_timer == 0)
             {
                 /* The timer has expired; preempt the running process */
-                simulator_cpu_data[cpu_id].state = CPU_PREEMPT;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-
-                /* Ensure the scheduler gets run before the simulator */
-                pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
-                    &simulator_mutex);
+                return CPU_PREEMPT;
             }
         }
         else
@@ -500,25 +1139,11 @@ static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
                 submit_io_request(pcb, pc->time);
 
                 /* Generate a yield() call on the appropriate CPU */
-                simulator_cpu_data[cpu_id].state = CPU_YIELD;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-
-                /* Ensure the scheduler gets run before the simulator */
-                pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
-                    &simulator_mutex);
-
-                break;
+                return CPU_YIELD;
 
             case OP_TERMINATE:
                 /* Generate a terminate() call on the appropriate CPU */
-                simulator_cpu_data[cpu_id].state = CPU_TERMINATE;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-
-                /* Ensure the scheduler gets run before the simulator */
-                pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
-                    &simulator_mutex);
-
-                break;
+                return CPU_TERMINATE;
 
             case OP_CPU:
                 break;
@@ -536,6 +1161,7 @@ static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
         printf("Scheduled a terminated process! PID: %d\n", pcb->pid);
         break;
     }
+    return CPU_RUNNING;
 }
 
 static void submit_io_request(pcb_t *pcb, unsigned int execution_time)
@@ -587,37 +1213,325 @@ static void simulate_io(void)
             io_queue_tail = NULL;
         free(completed);
 
-        /* Call the student's wake_up() handler */
-        pthread_mutex_unlock(&simulator_mutex);
-        IRWL_WRITER_LOCK(student_lock);
-        wake_up(pcb);
-        IRWL_WRITER_UNLOCK(student_lock);
-        pthread_mutex_lock(&simulator_mutex);
+        /* The student's code hears about it in simulate_wake_ups() */
+        wake_batch[wake_batch_size++] = pcb;
     }
 }
 
 static void simulate_creat(void)
 {
-    static int processes_created = 0;
-
     if ((simulator_time % 10) == 0 && processes_created < PROCESS_COUNT)
     {
-        /* Call student's wake_up() handler */
-        pthread_mutex_unlock(&simulator_mutex);
-        IRWL_WRITER_LOCK(student_lock);
-        wake_up(&processes[processes_created]);
-        IRWL_WRITER_UNLOCK(student_lock);
-        pthread_mutex_lock(&simulator_mutex);
-
+        /* The student's code hears about it in simulate_wake_ups() */
+        wake_batch[wake_batch_size++] = &processes[processes_created];
         processes_created++;
     }
 }
 
 
+/*
+ * simulate_wake_ups() calls the student's wake_up_batch() handler once for
+ * everything simulate_io() and simulate_creat() made ready this tick.
+ */
+static void simulate_wake_ups(void)
+{
+    unsigned int count = wake_batch_size;
+
+    if (count == 0)
+        return;
+
+    wake_batch_size = 0;
+    SIMULATOR_UNLOCK();
+    IRWL_WRITER_LOCK(student_lock);
+    wake_up_batch(wake_batch, count);
+    IRWL_WRITER_UNLOCK(student_lock);
+    SIMULATOR_LOCK();
+
+    if (simulator_flags & (SIM_INLINE | SIM_COROUTINES))
+        simulate_idle_cpus();
+}
+
+
+
+
+/*
+ * A CPU has settled once it has nothing left to do in real time before the
+ * next tick: a CPU with a process is back in its loop in CPU_RUNNING, and
+ * an idle CPU is parked in idle_wait() with no kick pending (with
+ * SIM_INLINE, idle() has always returned by then).  Until then a CPU woken
+ * out of idle() is still picking its process, at some point in real time.
+ * The CPU threads have settled when every CPU has.  A scheduler that keeps
+ * work READY while a CPU sleeps has settled as well; that is its choice.
+ *
+ * All of these are called with simulator_mutex held.
+ */
+static int simulator_cpu_settled(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
+    if (cpu->current != NULL)
+        return __atomic_load_n(&cpu->state, __ATOMIC_ACQUIRE) == CPU_RUNNING;
+    return (simulator_flags & SIM_INLINE) || __atomic_load_n(&cpu->parked, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * simulator_unsettled_cpu() returns a CPU that has not settled, or -1.  It
+ * clears the waking_cpus bit of each idle CPU it finds settled; the bit is
+ * cleared before the check, so a kick in between sets it again.
+ */
+static int simulator_unsettled_cpu(void)
+{
+    unsigned int word;
+    unsigned long bits, bit;
+    int n;
+
+    for (n = next_cpu(busy_cpus, 0); n >= 0; n = next_cpu(busy_cpus, (unsigned int)n + 1))
+    {
+        if (!simulator_cpu_settled((unsigned int)n))
+            return n;
+    }
+
+    for (word=0; word<busy_words; word++)
+    {
+        bits = __atomic_load_n(&waking_cpus[word], __ATOMIC_SEQ_CST);
+        while (bits != 0)
+        {
+            n = (int)(word * CPU_WORD_BITS) + __builtin_ctzl(bits);
+            bit = bits & -bits;
+            bits &= ~bit;
+            __atomic_and_fetch(&waking_cpus[word], ~bit, __ATOMIC_SEQ_CST);
+            if (!simulator_cpu_settled((unsigned int)n))
+            {
+                __atomic_or_fetch(&waking_cpus[word], bit, __ATOMIC_SEQ_CST);
+                return n;
+            }
+        }
+    }
+    return -1;
+}
+
+static int simulator_settled(void)
+{
+    return simulator_unsettled_cpu() < 0;
+}
+
+/*
+ * Unthrottled mode (SIM_UNTHROTTLED) calls simulator_settle() between ticks
+ * in place of the sleep.  It waits for each CPU that has not settled on its
+ * done eventcount, which a CPU thread signals both when it gets back to its
+ * loop and when it parks in idle_wait(), the only two ways it can settle.
+ * Called without simulator_mutex.
+ */
+static void simulator_settle(void)
+{
+    unsigned int key;
+    int n, settled;
+
+    while (1)
+    {
+        SIMULATOR_LOCK();
+        n = simulator_unsettled_cpu();
+        SIMULATOR_UNLOCK();
+        if (n < 0)
+            return;
+
+        key = eventcount_prepare(&simulator_cpu_data[n].done);
+        SIMULATOR_LOCK();
+        settled = simulator_cpu_settled((unsigned int)n);
+        SIMULATOR_UNLOCK();
+        if (!settled)
+            eventcount_wait(&simulator_cpu_data[n].done, key);
+    }
+}
+
+
+/*
+ * Event-driven mode (SIM_EVENT_DRIVEN).  simulator_quiet_ticks() returns
+ * how many ticks, starting with the current one, would pass with nothing
+ * for the student's code to do: no burst ending, no timeslice expiring, no
+ * I/O completing and no process arriving.  simulate_quiet_ticks() then
+ * accounts for them in one step.  Ticks are only skipped once the CPU
+ * threads have settled; before that the tick is simulated the ordinary
+ * way.
+ *
+ * Both are called by the supervisor with simulator_mutex held.
+ */
+static unsigned int simulator_quiet_ticks(void)
+{
+    unsigned int quiet = UINT_MAX;
+    int n;
+
+    if (!simulator_settled())
+        return 0;
+
+    for (n = next_cpu(busy_cpus, 0); n >= 0; n = next_cpu(busy_cpus, (unsigned int)n + 1))
+    {
+        pcb_t *pcb = simulator_cpu_data[n].current;
+        int timer = simulator_cpu_data[n].preemption_timer;
+
+        if (pcb->pc->type != OP_CPU)
+            return 0;
+
+        /* The burst ends at the tick pc->time reaches 0; the timer fires on 1 */
+        if (pcb->pc->time < quiet)
+            quiet = pcb->pc->time;
+        if (timer > 0 && (unsigned int)timer - 1 < quiet)
+            quiet = (unsigned int)timer - 1;
+    }
+
+    if (io_queue_head != NULL && io_queue_head->execution_time < quiet)
+        quiet = io_queue_head->execution_time;
+    if (processes_created < PROCESS_COUNT && (10 - simulator_time % 10) % 10 < quiet)
+        quiet = (10 - simulator_time % 10) % 10;
+
+    /* Nothing pending at all: leave it to the ordinary loop */
+    return quiet == UINT_MAX ? 0 : quiet;
+}
+
+static void simulate_quiet_ticks(unsigned int ticks)
+{
+    unsigned int n;
+    int cpu;
+
+    if (ticks == 0)
+        return;
+
+    for (n=0; n<ticks; n++)
+    {
+        print_gantt_line();
+        __atomic_store_n(&simulator_time, simulator_time + 1, __ATOMIC_RELEASE);
+    }
+
+    for (cpu = next_cpu(busy_cpus, 0); cpu >= 0; cpu = next_cpu(busy_cpus, (unsigned int)cpu + 1))
+    {
+        pcb_t *pcb = simulator_cpu_data[cpu].current;
+
+        pcb->pc->time -= ticks;
+        pcb->time_remaining = pcb->pc->time + 1;
+        simulator_cpu_data[cpu].preemption_timer -= (int)ticks;
+    }
+    if (io_queue_head != NULL)
+        io_queue_head->execution_time -= ticks;
+}
+
+
+/*
+ * The body of a coroutine CPU: simulator_cpu_thread(), except that it
+ * must let go of simulator_mutex before it switches away.
+ */
+static void simulator_cpu_coroutine(void)
+{
+    unsigned int cpu_id = (unsigned int)running_coroutine;
+    simulator_cpu_state_t state;
+
+    while (1)
+    {
+        SIMULATOR_LOCK();
+        if (simulator_cpu_data[cpu_id].current == NULL)
+            simulator_cpu_data[cpu_id].state = CPU_IDLE;
+        else
+        {
+            simulator_cpu_data[cpu_id].state = CPU_RUNNING;
+            while (simulator_cpu_data[cpu_id].state == CPU_RUNNING)
+            {
+                SIMULATOR_UNLOCK();
+                coroutine_block();
+                SIMULATOR_LOCK();
+            }
+        }
+        state = simulator_cpu_data[cpu_id].state;
+        SIMULATOR_UNLOCK();
+
+        simulator_call_student(cpu_id, state);
+    }
+}
+
+/* coroutine_resume() runs a CPU's coroutine until it calls coroutine_block() */
+static void coroutine_resume(unsigned int cpu_id)
+{
+    int previous = running_coroutine;
+    ucontext_t *self = previous < 0 ? &supervisor_context : &coroutines[previous].context;
+
+    coroutines[cpu_id].resumer = self;
+    running_coroutine = (int)cpu_id;
+    swapcontext(self, &coroutines[cpu_id].context);
+    running_coroutine = previous;
+}
+
+static void coroutine_block(void)
+{
+    simulator_coroutine_t *self = &coroutines[running_coroutine];
+
+    swapcontext(&self->context, self->resumer);
+}
+
+
+extern void idle_wait(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
+    assert(cpu_id < cpu_count && !(simulator_flags & SIM_INLINE));
+
+    if (simulator_flags & SIM_COROUTINES)
+    {
+        if (!cpu->kicked)
+        {
+            coroutines[cpu_id].idle_waiting = 1;
+            __atomic_store_n(&cpu->parked, 1, __ATOMIC_RELEASE);
+            coroutine_block();
+            coroutines[cpu_id].idle_waiting = 0;
+        }
+        cpu->kicked = 0;
+        return;
+    }
+
+    pthread_mutex_lock(&cpu->idle_mutex);
+    if (!cpu->kicked)
+    {
+        /* This CPU has settled; simulator_settle() may be waiting for it */
+        __atomic_store_n(&cpu->parked, 1, __ATOMIC_RELEASE);
+        eventcount_signal(&cpu->done);
+    }
+    while (!cpu->kicked)
+        pthread_cond_wait(&cpu->idle_wakeup, &cpu->idle_mutex);
+    cpu->kicked = 0;
+    pthread_mutex_unlock(&cpu->idle_mutex);
+}
+
+extern void idle_kick(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
+    assert(cpu_id < cpu_count);
+
+    if (simulator_flags & SIM_COROUTINES)
+    {
+        /* Everything runs on the supervisor thread, which resumes it later */
+        cpu->kicked = 1;
+        __atomic_store_n(&cpu->parked, 0, __ATOMIC_RELEASE);
+        __atomic_or_fetch(&waking_cpus[cpu_id / CPU_WORD_BITS],
+            1ul << (cpu_id % CPU_WORD_BITS), __ATOMIC_SEQ_CST);
+        if (coroutines[cpu_id].idle_waiting)
+        {
+            pending_cpus[cpu_id / CPU_WORD_BITS] |= 1ul << (cpu_id % CPU_WORD_BITS);
+            idle_poll_pending = 1;
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&cpu->idle_mutex);
+    cpu->kicked = 1;
+    __atomic_store_n(&cpu->parked, 0, __ATOMIC_RELEASE);
+    __atomic_or_fetch(&waking_cpus[cpu_id / CPU_WORD_BITS],
+        1ul << (cpu_id % CPU_WORD_BITS), __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&cpu->idle_wakeup);
+    pthread_mutex_unlock(&cpu->idle_mutex);
+}
 
 /* Cheap hack -- passing an int through a void pointer */
 static void *simulator_cpu_thread_func(void *data)
 {
+    lockstat_set_thread((unsigned int)(uintptr_t)data + 1);
     simulator_cpu_thread((unsigned int)(uintptr_t)data);
     return NULL;
 }
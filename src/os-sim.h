@@ -35,14 +35,19 @@ typedef enum {
  *         time first algorithm. 
  *
  *   state : The current state of the process.  This should be updated by the
- *        student's code in each of the handlers.  See the task_state_t
- *        struct above for possible values.
+ *        student's code in each of the handlers, through set_process_state().
+ *        See the task_state_t struct above for possible values.
  *
  *   pc : The "program counter" of the process.  This value is actually used
  *        by the simulator to simulate the process.  Do not touch.
  *
  *   next : An unused pointer to another PCB.  You may use this pointer to
  *        build a linked-list of PCBs.
+ *
+ *   priority : The static priority of the process; lower is better.
+ *
+ *   last_cpu : The CPU the process last ran on, or -1 if it has not run
+ *        yet.  Updated by context_switch(). (read-only)
  */
 typedef enum { OP_CPU = 0, OP_IO, OP_TERMINATE } op_type;
 
@@ -60,16 +65,61 @@ typedef struct _pcb_t {
     op_t *pc;
     struct _pcb_t *next;
     int priority;
+    int last_cpu;
 } pcb_t;
 
 
 /*
- * start_simulator() runs the OS simulation.  The number of CPUs (1-16) should
- * be passed as the parameter.
+ * start_simulator() runs the OS simulation.  The number of CPUs (1 to
+ * SIM_MAX_CPUS) should be passed as the parameter.
  */
+#ifndef SIM_MAX_CPUS
+#define SIM_MAX_CPUS 1024
+#endif
+
 extern void start_simulator(unsigned int cpu_count);
 
 
+/*
+ * set_simulator_flags() changes how the simulator runs.  It must be called
+ * before start_simulator().
+ *
+ *   SIM_EVENT_DRIVEN : jump over ticks in which no burst ends, no I/O
+ *          completes, no process arrives and no timeslice expires, once
+ *          every CPU thread has settled.  The output is the same as
+ *          stepping through them one at a time.
+ *   SIM_UNTHROTTLED : do not sleep between ticks; instead wait until every
+ *          CPU has settled: each busy CPU is back waiting for its next
+ *          event and each idle one is parked in idle_wait().  No tick then
+ *          starts with a dispatch still in progress, which the sleep only
+ *          usually allows for, so results can differ from a throttled run.
+ *          Which idle CPU takes which process still depends on thread
+ *          timing, so runs are not deterministic; SIM_INLINE is.
+ *   SIM_INLINE : run every handler on the supervisor thread, with no CPU
+ *          threads, so a run is deterministic.  idle() must return
+ *          without waiting when there is nothing to run; the simulator
+ *          calls it again for each idle CPU, in CPU order, whenever work
+ *          may have arrived.
+ *   SIM_COROUTINES : run each CPU as a coroutine on the supervisor thread
+ *          instead of as a thread of its own.  idle() waits as usual, in
+ *          idle_wait().  Cannot be combined with SIM_INLINE.
+ *   SIM_PARALLEL : advance every busy CPU through the tick first, then
+ *          hand out all of the tick's preempt, yield and terminate events
+ *          at once and wait for the last handler, instead of waiting for
+ *          each handler before looking at the next CPU.  The handlers run
+ *          concurrently.  A CPU that one of them starts is first
+ *          simulated on the next tick.  Needs CPU threads, so it cannot
+ *          be combined with SIM_INLINE or SIM_COROUTINES.
+ */
+#define SIM_EVENT_DRIVEN 0x1
+#define SIM_UNTHROTTLED  0x2
+#define SIM_INLINE       0x4
+#define SIM_COROUTINES   0x8
+#define SIM_PARALLEL     0x10
+
+extern void set_simulator_flags(unsigned int flags);
+
+
 /*
  * context_switch() schedules a process on a CPU.  Note that it is
  * non-blocking.  It does not actually simulate the execution of the process;
@@ -77,16 +127,48 @@ extern void start_simulator(unsigned int cpu_count);
  *
  *       cpu_id : the # of the CPU on which to execute the process
  *          pcb : a pointer to the process's PCB
+ *   preemption_time : the number of ticks the process may run before the
+ *          simulator preempts it, or -1 for an infinite timeslice
  */
-extern void context_switch(unsigned int cpu_id, pcb_t *pcb);
+extern void context_switch(unsigned int cpu_id, pcb_t *pcb, int preemption_time);
 
 
 /*
  * force_preempt() preempts a running process before its timeslice expires.
  * It should be used by the SRTF scheduler to preempt lower
  * priority processes so that higher priority processes may execute.
+ * It returns 1 once preempt() has run for the CPU, or 0 if the CPU was not
+ * running a process to preempt (it was yielding, terminating or still
+ * being dispatched), in which case preempt() is not called.
+ */
+extern int force_preempt(unsigned int cpu_id);
+
+
+/*
+ * set_process_state() changes a process's state.  The student's code should
+ * always use it rather than storing to pcb->state, so the Gantt chart can
+ * read every state without waiting for the handlers.  It may be called from
+ * any thread, with or without locks held.
+ */
+extern void set_process_state(pcb_t *pcb, process_state_t state);
+
+
+/*
+ * get_simulator_time() returns the current simulated time in ticks
+ * (tenths of a second).  It may be called from any handler.
+ */
+extern unsigned int get_simulator_time(void);
+
+
+/*
+ * idle_wait() is how idle() waits for work: it returns once idle_kick()
+ * has been called for cpu_id since the last idle_wait() returned, at once
+ * if it already has.  idle_kick() may be called from any handler.  Waiting
+ * through these rather than a condition variable of its own lets idle()
+ * run on a CPU that is a coroutine rather than a thread.
  */
-extern void force_preempt(unsigned int cpu_id);
+extern void idle_wait(unsigned int cpu_id);
+extern void idle_kick(unsigned int cpu_id);
 
 
 /*
@@ -0,0 +1,102 @@
+/*
+ * prio-array.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Bitmap-indexed array of per-level PCB FIFOs.  See prio-array.h.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "prio-array.h"
+
+
+static void prio_array_mark(prio_array_t *array, unsigned int level)
+{
+    array->bitmap[level / PRIO_ARRAY_WORD_BITS] |= 1ul << (level % PRIO_ARRAY_WORD_BITS);
+}
+
+static void prio_array_unmark(prio_array_t *array, unsigned int level)
+{
+    array->bitmap[level / PRIO_ARRAY_WORD_BITS] &= ~(1ul << (level % PRIO_ARRAY_WORD_BITS));
+}
+
+
+extern void prio_array_init(prio_array_t *array, unsigned int levels)
+{
+    unsigned int n;
+
+    assert(levels > 0);
+    array->levels = levels;
+    array->words = (levels + (unsigned int)PRIO_ARRAY_WORD_BITS - 1) / (unsigned int)PRIO_ARRAY_WORD_BITS;
+    array->queues = malloc(sizeof(pcb_fifo_t) * levels);
+    array->bitmap = calloc(array->words, sizeof(unsigned long));
+    assert(array->queues != NULL && array->bitmap != NULL);
+
+    for (n = 0; n < levels; n++)
+        fifo_init(&array->queues[n]);
+    array->size = 0;
+}
+
+extern void prio_array_destroy(prio_array_t *array)
+{
+    free(array->queues);
+    free(array->bitmap);
+    array->levels = 0;
+    array->words = 0;
+    array->size = 0;
+}
+
+extern void prio_array_push(prio_array_t *array, pcb_t *pcb, unsigned int level)
+{
+    assert(level < array->levels);
+
+    fifo_push(&array->queues[level], pcb);
+    prio_array_mark(array, level);
+    array->size++;
+}
+
+extern pcb_t *prio_array_pop(prio_array_t *array)
+{
+    int level = prio_array_first(array);
+    pcb_t *pcb;
+
+    if (level < 0)
+        return NULL;
+
+    pcb = fifo_pop(&array->queues[level]);
+    if (fifo_empty(&array->queues[level]))
+        prio_array_unmark(array, (unsigned int)level);
+    array->size--;
+    return pcb;
+}
+
+extern int prio_array_first(const prio_array_t *array)
+{
+    unsigned int word;
+
+    for (word = 0; word < array->words; word++)
+    {
+        if (array->bitmap[word] != 0)
+            return (int)(word * PRIO_ARRAY_WORD_BITS) + __builtin_ctzl(array->bitmap[word]);
+    }
+    return -1;
+}
+
+extern void prio_array_flatten(prio_array_t *array)
+{
+    unsigned int level;
+
+    for (level = 1; level < array->levels; level++)
+    {
+        fifo_splice(&array->queues[0], &array->queues[level]);
+        prio_array_unmark(array, level);
+    }
+    if (!fifo_empty(&array->queues[0]))
+        prio_array_mark(array, 0);
+}
+
+extern int prio_array_empty(const prio_array_t *array)
+{
+    return array->size == 0;
+}
@@ -0,0 +1,48 @@
+/*
+ * prio-array.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * An array of PCB FIFOs, one per priority level, plus an occupancy bitmap
+ * with one bit per level.  Level 0 is the highest priority.  Finding the
+ * highest non-empty level is a find-first-set on the bitmap, one word per
+ * 64 levels, so push and pop are O(1) however many PCBs are queued.
+ *
+ * The array does no locking of its own.
+ */
+
+#ifndef __PRIO_ARRAY_H__
+#define __PRIO_ARRAY_H__
+
+#include "fifo.h"
+
+
+#define PRIO_ARRAY_WORD_BITS (8 * sizeof(unsigned long))
+
+typedef struct {
+    pcb_fifo_t *queues;         /* queues[level] */
+    unsigned long *bitmap;      /* bit level is set when queues[level] is non-empty */
+    unsigned int levels;
+    unsigned int words;
+    unsigned int size;          /* PCBs queued across all levels */
+} prio_array_t;
+
+
+extern void prio_array_init(prio_array_t *array, unsigned int levels);
+extern void prio_array_destroy(prio_array_t *array);
+
+/* prio_array_push() appends pcb to the tail of the FIFO for level. */
+extern void prio_array_push(prio_array_t *array, pcb_t *pcb, unsigned int level);
+
+/* prio_array_pop() takes the head of the highest non-empty level, or NULL. */
+extern pcb_t *prio_array_pop(prio_array_t *array);
+
+/* prio_array_first() returns the highest non-empty level, or -1. */
+extern int prio_array_first(const prio_array_t *array);
+
+/* prio_array_flatten() moves every queued PCB to level 0, keeping order. */
+extern void prio_array_flatten(prio_array_t *array);
+
+extern int prio_array_empty(const prio_array_t *array);
+
+
+#endif /* __PRIO_ARRAY_H__ */
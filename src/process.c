@@ -224,14 +224,14 @@ static op_t pid7_ops[] = {
 };
 
 pcb_t processes[PROCESS_COUNT] = {
-    { 0, "Montpelier", 96, PROCESS_NEW, pid0_ops, NULL, 5 },
-    { 1, "Pierre", 80, PROCESS_NEW, pid1_ops, NULL, 1 },
-    { 2, "Hartford", 89, PROCESS_NEW, pid2_ops, NULL, 6 },
-    { 3, "Lansing", 99, PROCESS_NEW, pid3_ops, NULL, 8 },
-    { 4, "Helena", 130, PROCESS_NEW, pid4_ops, NULL, 2 },
-    { 5, "Concord",127, PROCESS_NEW, pid5_ops, NULL, 7 },
-    { 6, "Trenton", 159, PROCESS_NEW, pid6_ops, NULL, 3 },
-    { 7, "Bismark", 109, PROCESS_NEW, pid7_ops, NULL, 4 }
+    { 0, "Montpelier", 96, PROCESS_NEW, pid0_ops, NULL, 5, -1 },
+    { 1, "Pierre", 80, PROCESS_NEW, pid1_ops, NULL, 1, -1 },
+    { 2, "Hartford", 89, PROCESS_NEW, pid2_ops, NULL, 6, -1 },
+    { 3, "Lansing", 99, PROCESS_NEW, pid3_ops, NULL, 8, -1 },
+    { 4, "Helena", 130, PROCESS_NEW, pid4_ops, NULL, 2, -1 },
+    { 5, "Concord",127, PROCESS_NEW, pid5_ops, NULL, 7, -1 },
+    { 6, "Trenton", 159, PROCESS_NEW, pid6_ops, NULL, 3, -1 },
+    { 7, "Bismark", 109, PROCESS_NEW, pid7_ops, NULL, 4, -1 }
 };
 
 
@@ -0,0 +1,285 @@
+/*
+ * rbtree.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Intrusive red-black tree.  See rbtree.h.  NULL children count as black
+ * leaves.
+ */
+
+#include <stdlib.h>
+
+#include "rbtree.h"
+
+
+static int is_red(const rb_node_t *node)
+{
+    return node != NULL && node->red;
+}
+
+static void rb_replace_child(rb_tree_t *tree, rb_node_t *parent, rb_node_t *old, rb_node_t *new)
+{
+    if (parent == NULL)
+        tree->root = new;
+    else if (parent->left == old)
+        parent->left = new;
+    else
+        parent->right = new;
+    if (new != NULL)
+        new->parent = parent;
+}
+
+static void rb_rotate_left(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *pivot = node->right;
+
+    node->right = pivot->left;
+    if (pivot->left != NULL)
+        pivot->left->parent = node;
+    rb_replace_child(tree, node->parent, node, pivot);
+    pivot->left = node;
+    node->parent = pivot;
+}
+
+static void rb_rotate_right(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *pivot = node->left;
+
+    node->left = pivot->right;
+    if (pivot->right != NULL)
+        pivot->right->parent = node;
+    rb_replace_child(tree, node->parent, node, pivot);
+    pivot->right = node;
+    node->parent = pivot;
+}
+
+static rb_node_t *rb_min(rb_node_t *node)
+{
+    while (node->left != NULL)
+        node = node->left;
+    return node;
+}
+
+static rb_node_t *rb_next(rb_node_t *node)
+{
+    rb_node_t *parent;
+
+    if (node->right != NULL)
+        return rb_min(node->right);
+    parent = node->parent;
+    while (parent != NULL && node == parent->right)
+    {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent;
+}
+
+
+extern void rb_init(rb_tree_t *tree)
+{
+    tree->root = NULL;
+    tree->leftmost = NULL;
+    tree->size = 0;
+}
+
+extern void rb_insert(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *parent = NULL;
+    rb_node_t **link = &tree->root;
+    int leftmost = 1;
+
+    while (*link != NULL)
+    {
+        parent = *link;
+        if (node->key < parent->key)
+        {
+            link = &parent->left;
+        }
+        else
+        {
+            link = &parent->right;
+            leftmost = 0;
+        }
+    }
+
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = 1;
+    *link = node;
+    if (leftmost)
+        tree->leftmost = node;
+    tree->size++;
+
+    /* Fix up a red node with a red parent */
+    while (is_red(node->parent))
+    {
+        rb_node_t *grandparent = node->parent->parent;
+        rb_node_t *uncle;
+
+        if (node->parent == grandparent->left)
+        {
+            uncle = grandparent->right;
+            if (is_red(uncle))
+            {
+                node->parent->red = 0;
+                uncle->red = 0;
+                grandparent->red = 1;
+                node = grandparent;
+                continue;
+            }
+            if (node == node->parent->right)
+            {
+                node = node->parent;
+                rb_rotate_left(tree, node);
+            }
+            node->parent->red = 0;
+            grandparent->red = 1;
+            rb_rotate_right(tree, grandparent);
+        }
+        else
+        {
+            uncle = grandparent->left;
+            if (is_red(uncle))
+            {
+                node->parent->red = 0;
+                uncle->red = 0;
+                grandparent->red = 1;
+                node = grandparent;
+                continue;
+            }
+            if (node == node->parent->left)
+            {
+                node = node->parent;
+                rb_rotate_right(tree, node);
+            }
+            node->parent->red = 0;
+            grandparent->red = 1;
+            rb_rotate_left(tree, grandparent);
+        }
+    }
+    tree->root->red = 0;
+}
+
+extern void rb_erase(rb_tree_t *tree, rb_node_t *node)
+{
+    rb_node_t *child;
+    rb_node_t *parent;
+    int removed_red;
+
+    if (tree->leftmost == node)
+        tree->leftmost = rb_next(node);
+
+    if (node->left == NULL || node->right == NULL)
+    {
+        child = node->left != NULL ? node->left : node->right;
+        parent = node->parent;
+        removed_red = node->red;
+        rb_replace_child(tree, parent, node, child);
+    }
+    else
+    {
+        /* Splice out the in-order successor and put it where node was */
+        rb_node_t *successor = rb_min(node->right);
+
+        child = successor->right;
+        removed_red = successor->red;
+        if (successor->parent == node)
+        {
+            parent = successor;
+        }
+        else
+        {
+            parent = successor->parent;
+            rb_replace_child(tree, parent, successor, child);
+            successor->right = node->right;
+            successor->right->parent = successor;
+        }
+        rb_replace_child(tree, node->parent, node, successor);
+        successor->left = node->left;
+        successor->left->parent = successor;
+        successor->red = node->red;
+    }
+    tree->size--;
+
+    if (removed_red)
+        return;
+
+    /* child carries an extra black; push it up until it can be absorbed */
+    while (child != tree->root && !is_red(child))
+    {
+        rb_node_t *sibling;
+
+        if (child == parent->left)
+        {
+            sibling = parent->right;
+            if (is_red(sibling))
+            {
+                sibling->red = 0;
+                parent->red = 1;
+                rb_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+            if (!is_red(sibling->left) && !is_red(sibling->right))
+            {
+                sibling->red = 1;
+                child = parent;
+                parent = child->parent;
+                continue;
+            }
+            if (!is_red(sibling->right))
+            {
+                sibling->left->red = 0;
+                sibling->red = 1;
+                rb_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->red = parent->red;
+            parent->red = 0;
+            sibling->right->red = 0;
+            rb_rotate_left(tree, parent);
+        }
+        else
+        {
+            sibling = parent->left;
+            if (is_red(sibling))
+            {
+                sibling->red = 0;
+                parent->red = 1;
+                rb_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+            if (!is_red(sibling->left) && !is_red(sibling->right))
+            {
+                sibling->red = 1;
+                child = parent;
+                parent = child->parent;
+                continue;
+            }
+            if (!is_red(sibling->left))
+            {
+                sibling->right->red = 0;
+                sibling->red = 1;
+                rb_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->red = parent->red;
+            parent->red = 0;
+            sibling->left->red = 0;
+            rb_rotate_right(tree, parent);
+        }
+        child = tree->root;
+    }
+    if (child != NULL)
+        child->red = 0;
+}
+
+extern rb_node_t *rb_first(const rb_tree_t *tree)
+{
+    return tree->leftmost;
+}
+
+extern int rb_empty(const rb_tree_t *tree)
+{
+    return tree->root == NULL;
+}
@@ -0,0 +1,47 @@
+/*
+ * rbtree.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * An intrusive red-black tree ordered by an unsigned long key.  The caller
+ * owns the nodes (typically one per PID) and sets rb_node_t::key before
+ * inserting.  Nodes with equal keys are kept in insertion order.  Insert and
+ * erase are O(log n); the leftmost (smallest) node is cached, so finding it
+ * is O(1).
+ *
+ * The tree does no locking of its own.
+ */
+
+#ifndef __RBTREE_H__
+#define __RBTREE_H__
+
+
+typedef struct _rb_node_t {
+    struct _rb_node_t *parent;
+    struct _rb_node_t *left;
+    struct _rb_node_t *right;
+    int red;
+    unsigned long key;
+} rb_node_t;
+
+typedef struct {
+    rb_node_t *root;
+    rb_node_t *leftmost;
+    unsigned int size;
+} rb_tree_t;
+
+
+extern void rb_init(rb_tree_t *tree);
+
+/* rb_insert() adds node, which must not already be in a tree. */
+extern void rb_insert(rb_tree_t *tree, rb_node_t *node);
+
+/* rb_erase() takes node out of tree, wherever it is. */
+extern void rb_erase(rb_tree_t *tree, rb_node_t *node);
+
+/* rb_first() returns the node with the smallest key, or NULL. */
+extern rb_node_t *rb_first(const rb_tree_t *tree);
+
+extern int rb_empty(const rb_tree_t *tree);
+
+
+#endif /* __RBTREE_H__ */
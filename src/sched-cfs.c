@@ -0,0 +1,202 @@
+/*
+ * sched-cfs.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Completely fair scheduling (-v).  Each process accumulates virtual
+ * runtime, the ticks it has run scaled by CFS_NICE_0_WEIGHT / its weight,
+ * and the process with the least virtual runtime runs next.
+ * pcb_t::priority is read as a Linux nice value (clamped to -20..19) and
+ * mapped through the same weight table, so each step of priority is worth
+ * about 25% more or less CPU.  Virtual runtime is kept in
+ * 1/CFS_VRUNTIME_SCALE of a tick.  READY processes sit in a red-black tree
+ * of PIDs keyed on virtual runtime, so insert is O(log n) and the leftmost
+ * node is cached.
+ *
+ * A process is dispatched for its weighted share of the scheduling period,
+ * CFS_LATENCY ticks stretched to CFS_MIN_GRANULARITY per runnable process
+ * when there are many, so the timeslice shrinks as the run queue grows.
+ * The share is of the run queue's whole load, the processes running from
+ * it as well as those queued, so it does not grow as the queue drains.  A
+ * process that wakes up is placed no further than CFS_WAKEUP_CREDIT behind
+ * the run queue's min_vruntime, so sleeping does not bank unbounded credit.
+ *
+ * Virtual runtime only means something relative to one run queue's
+ * min_vruntime.  cfs_home[pid] is the run queue a process last joined; one
+ * that moves to another (stolen with -l) keeps its distance from
+ * min_vruntime rather than its raw virtual runtime.
+ *
+ * cfs_nodes[pid].key is the process's virtual runtime and, like the MLFQ
+ * level, is only touched by the thread currently handling the process.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "rbtree.h"
+#include "sched-policy.h"
+
+
+#define CFS_NICE_0_WEIGHT 1024
+#define CFS_VRUNTIME_SCALE 1024ul
+#define CFS_LATENCY 6
+#define CFS_MIN_GRANULARITY 1
+#define CFS_WAKEUP_CREDIT (CFS_LATENCY * CFS_VRUNTIME_SCALE / 2)
+
+/*
+ * load and nr_running cover the processes in tree and those picked from it
+ * that are still running.  A running process is taken off by cfs_stop(),
+ * without the run queue's lock, so both are updated atomically.
+ */
+typedef struct {
+    rb_tree_t tree;
+    unsigned long min_vruntime; /* never decreases; see cfs_enqueue() */
+    unsigned long load;         /* sum of the weights of those processes */
+    unsigned long nr_running;
+} cfs_rq_t;
+
+static const unsigned int cfs_nice_weights[40] = {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */ 9548, 7620, 6100, 4904, 3906,
+    /*  -5 */ 3121, 2501, 1991, 1586, 1277,
+    /*   0 */ 1024, 820, 655, 526, 423,
+    /*   5 */ 335, 272, 215, 172, 137,
+    /*  10 */ 110, 87, 70, 56, 45,
+    /*  15 */ 36, 29, 23, 18, 15,
+};
+
+static rb_node_t cfs_nodes[PROCESS_COUNT];
+static cfs_rq_t *cfs_home[PROCESS_COUNT];
+static int cfs_slice[PROCESS_COUNT];
+static unsigned int cfs_dispatched[PROCESS_COUNT];
+
+
+static unsigned long cfs_weight(const pcb_t *process)
+{
+    int nice = process->priority < -20 ? -20 : process->priority > 19 ? 19 : process->priority;
+    return cfs_nice_weights[nice + 20];
+}
+
+/* Charges the process for the ticks it ran since it was dispatched */
+static void cfs_charge(const pcb_t *process)
+{
+    unsigned long ran = get_simulator_time() - cfs_dispatched[process->pid];
+    cfs_nodes[process->pid].key += ran * CFS_NICE_0_WEIGHT * CFS_VRUNTIME_SCALE / cfs_weight(process);
+}
+
+
+static void *cfs_rq_create(void)
+{
+    cfs_rq_t *rq = malloc(sizeof(cfs_rq_t));
+
+    assert(rq != NULL);
+    rb_init(&rq->tree);
+    rq->min_vruntime = 0;
+    rq->load = 0;
+    rq->nr_running = 0;
+    return rq;
+}
+
+/* Moves a virtual runtime from from's min_vruntime to to's */
+static unsigned long cfs_renormalize(unsigned long vruntime, const cfs_rq_t *from, const cfs_rq_t *to)
+{
+    unsigned long from_min = __atomic_load_n(&from->min_vruntime, __ATOMIC_RELAXED);
+
+    if (to->min_vruntime >= from_min) {
+        return vruntime + (to->min_vruntime - from_min);
+    }
+    return vruntime > from_min - to->min_vruntime ? vruntime - (from_min - to->min_vruntime) : 0;
+}
+
+static void cfs_enqueue(void *queue, pcb_t *process)
+{
+    cfs_rq_t *rq = queue;
+    rb_node_t *node = &cfs_nodes[process->pid];
+
+    if (cfs_home[process->pid] != NULL && cfs_home[process->pid] != rq) {
+        node->key = cfs_renormalize(node->key, cfs_home[process->pid], rq);
+    }
+    cfs_home[process->pid] = rq;
+    if (node->key + CFS_WAKEUP_CREDIT < rq->min_vruntime) {
+        node->key = rq->min_vruntime - CFS_WAKEUP_CREDIT;
+    }
+    rb_insert(&rq->tree, node);
+    __atomic_add_fetch(&rq->load, cfs_weight(process), __ATOMIC_RELAXED);
+    __atomic_add_fetch(&rq->nr_running, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Takes the leftmost process off the run queue and works out its
+ * timeslice.  It stays in the run queue's load until cfs_stop().
+ */
+static pcb_t *cfs_pick_next(void *queue)
+{
+    cfs_rq_t *rq = queue;
+    rb_node_t *node = rb_first(&rq->tree);
+    pcb_t *process = &processes[node - cfs_nodes];
+    unsigned long weight = cfs_weight(process);
+    unsigned long period = CFS_LATENCY;
+    unsigned long nr_running = __atomic_load_n(&rq->nr_running, __ATOMIC_RELAXED);
+    unsigned long slice;
+
+    if (nr_running * CFS_MIN_GRANULARITY > period) {
+        period = nr_running * CFS_MIN_GRANULARITY;
+    }
+    slice = period * weight / __atomic_load_n(&rq->load, __ATOMIC_RELAXED);
+    cfs_slice[process->pid] = slice > CFS_MIN_GRANULARITY ? (int)slice : CFS_MIN_GRANULARITY;
+
+    rb_erase(&rq->tree, node);
+    if (node->key > rq->min_vruntime) {
+        __atomic_store_n(&rq->min_vruntime, node->key, __ATOMIC_RELAXED);
+    }
+    return process;
+}
+
+static int cfs_timeslice(const pcb_t *process)
+{
+    return cfs_slice[process->pid];
+}
+
+static void cfs_run(unsigned int cpu_id, const pcb_t *process)
+{
+    (void)cpu_id;
+    cfs_dispatched[process->pid] = get_simulator_time();
+}
+
+/* The process leaves the CPU; it no longer counts in its run queue's load */
+static void cfs_stop(unsigned int cpu_id, const pcb_t *process)
+{
+    cfs_rq_t *rq = cfs_home[process->pid];
+
+    (void)cpu_id;
+    __atomic_sub_fetch(&rq->load, cfs_weight(process), __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&rq->nr_running, 1, __ATOMIC_RELAXED);
+}
+
+static void cfs_on_preempt(pcb_t *process, int expired)
+{
+    (void)expired;
+    cfs_charge(process);
+}
+
+static void cfs_on_yield(pcb_t *process)
+{
+    cfs_charge(process);
+}
+
+
+const sched_policy_t sched_cfs = {
+    .name = "cfs",
+    .option = 'v',
+    .help = "Completely Fair Scheduler, weighted by priority",
+    .rq_create = cfs_rq_create,
+    .enqueue = cfs_enqueue,
+    .pick_next = cfs_pick_next,
+    .timeslice = cfs_timeslice,
+    .run = cfs_run,
+    .stop = cfs_stop,
+    .on_preempt = cfs_on_preempt,
+    .on_yield = cfs_on_yield,
+};
@@ -0,0 +1,126 @@
+/*
+ * sched-fifo.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * First come first served and round robin.  Both keep READY processes in a
+ * head/tail FIFO in arrival order, so wake_up() and preempt() append and
+ * schedule() takes the head in O(1).  Round robin gives every dispatch the
+ * same timeslice.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "fifo.h"
+#include "sched-policy.h"
+
+
+/* Round robin timeslice in ticks (-r) */
+static int timeslice;
+
+/* FCFS audit mode (-a): how often arrival order and lowest-PID order differ */
+static int audit;
+static unsigned long audit_picks, audit_disagreements;
+
+
+static void *fifo_rq_create(void)
+{
+    pcb_fifo_t *fifo = malloc(sizeof(pcb_fifo_t));
+
+    assert(fifo != NULL);
+    fifo_init(fifo);
+    return fifo;
+}
+
+static void fifo_enqueue(void *rq, pcb_t *process)
+{
+    // Arrival order: [oldest process] -> ... -> [new process]
+    fifo_push(rq, process);
+}
+
+static pcb_t *fifo_pick_next(void *rq)
+{
+    return fifo_pop(rq);
+}
+
+/*
+ * In audit mode, compare each FCFS pick against the process the old
+ * lowest-PID scan would have picked.  This walks the whole queue, so it
+ * is only done when asked for with -a.
+ */
+static pcb_t *fcfs_pick_next(void *rq)
+{
+    pcb_t *picked = fifo_pop(rq);
+    const pcb_t *iter;
+    unsigned int min_PID = picked->pid;
+
+    if (!audit) {
+        return picked;
+    }
+    for (iter = ((pcb_fifo_t *)rq)->head; iter != NULL; iter = iter->next) {
+        if (iter->pid < min_PID) { min_PID = iter->pid; }
+    }
+    __atomic_add_fetch(&audit_picks, 1, __ATOMIC_RELAXED);
+    if (min_PID != picked->pid) {
+        __atomic_add_fetch(&audit_disagreements, 1, __ATOMIC_RELAXED);
+    }
+    return picked;
+}
+
+static void fcfs_print_stats(void)
+{
+    if (audit) {
+        printf("FCFS picks: %lu\n", audit_picks);
+        printf("Picks where arrival order and lowest-PID order disagree: %lu (%.1f%%)\n",
+            audit_disagreements,
+            audit_picks > 0 ? 100.0 * (double)audit_disagreements / (double)audit_picks : 0.0);
+    }
+}
+
+/* FCFS takes no argument, except "audit", which main() passes for -a */
+static int fcfs_configure(const char *arg)
+{
+    if (arg == NULL) {
+        return 0;
+    }
+    audit = strcmp(arg, "audit") == 0;
+    return !audit;
+}
+
+static int rr_configure(const char *arg)
+{
+    timeslice = atoi(arg);
+    return timeslice < 1;
+}
+
+static int rr_timeslice(const pcb_t *process)
+{
+    (void)process;
+    return timeslice;
+}
+
+
+const sched_policy_t sched_fcfs = {
+    .name = "fcfs",
+    .option = 'f',
+    .help = "FCFS Scheduler",
+    .configure = fcfs_configure,
+    .rq_create = fifo_rq_create,
+    .enqueue = fifo_enqueue,
+    .pick_next = fcfs_pick_next,
+    .print_stats = fcfs_print_stats,
+};
+
+const sched_policy_t sched_rr = {
+    .name = "rr",
+    .option = 'r',
+    .arg = "<time slice>",
+    .help = "Round-Robin Scheduler, time slice in tenths of a second",
+    .configure = rr_configure,
+    .rq_create = fifo_rq_create,
+    .enqueue = fifo_enqueue,
+    .pick_next = fifo_pick_next,
+    .timeslice = rr_timeslice,
+};
@@ -0,0 +1,146 @@
+/*
+ * sched-mlfq.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Multilevel feedback queue (-m <levels>).  Processes start at level 0,
+ * drop a level when their timeslice expires and climb one when they yield
+ * for I/O.  Level l runs for MLFQ_BASE_TIMESLICE << l ticks.  Each run
+ * queue keeps one FIFO per level in a prio_array_t, so the highest
+ * non-empty level is a single find-first-set.
+ *
+ * Every MLFQ_BOOST_INTERVAL ticks every process goes back to level 0 so
+ * CPU-bound work cannot starve: bumping mlfq_boost_epoch resets the
+ * recorded level of every process without touching them, and each run
+ * queue splices its levels onto level 0 the next time it is used.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "prio-array.h"
+#include "sched-policy.h"
+
+
+#define MLFQ_MAX_LEVELS 16
+#define MLFQ_BASE_TIMESLICE 2
+#define MLFQ_BOOST_INTERVAL 100
+
+#define MLFQ_STR(x) #x
+#define MLFQ_XSTR(x) MLFQ_STR(x)
+
+typedef struct {
+    prio_array_t levels;
+    unsigned int epoch;         /* boost this queue was last flattened for */
+} mlfq_rq_t;
+
+static unsigned int mlfq_levels;
+static unsigned int mlfq_level[PROCESS_COUNT];
+static unsigned int mlfq_epoch[PROCESS_COUNT];
+static unsigned int mlfq_boost_epoch;
+static unsigned int mlfq_next_boost = MLFQ_BOOST_INTERVAL;
+
+
+/*
+ * MLFQ level bookkeeping.  A process's level is only touched by the thread
+ * currently handling it, so it needs no lock of its own.
+ */
+static unsigned int mlfq_get_level(const pcb_t *process)
+{
+    if (mlfq_epoch[process->pid] != __atomic_load_n(&mlfq_boost_epoch, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    return mlfq_level[process->pid];
+}
+
+static void mlfq_set_level(const pcb_t *process, unsigned int level)
+{
+    mlfq_level[process->pid] = level;
+    mlfq_epoch[process->pid] = __atomic_load_n(&mlfq_boost_epoch, __ATOMIC_ACQUIRE);
+}
+
+/* The run queue's lock must be held by the caller */
+static void mlfq_boost_if_due(mlfq_rq_t *rq)
+{
+    unsigned int now = get_simulator_time();
+    unsigned int next = __atomic_load_n(&mlfq_next_boost, __ATOMIC_ACQUIRE);
+    unsigned int epoch;
+
+    // The first run queue to notice the boost is due starts a new epoch
+    if (now >= next && __atomic_compare_exchange_n(&mlfq_next_boost, &next,
+            now - now % MLFQ_BOOST_INTERVAL + MLFQ_BOOST_INTERVAL, 0,
+            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        __atomic_add_fetch(&mlfq_boost_epoch, 1, __ATOMIC_ACQ_REL);
+    }
+    epoch = __atomic_load_n(&mlfq_boost_epoch, __ATOMIC_ACQUIRE);
+    if (rq->epoch != epoch) {
+        prio_array_flatten(&rq->levels);
+        rq->epoch = epoch;
+    }
+}
+
+
+static int mlfq_configure(const char *arg)
+{
+    mlfq_levels = (unsigned int)atoi(arg);
+    return mlfq_levels < 1 || mlfq_levels > MLFQ_MAX_LEVELS;
+}
+
+static void *mlfq_rq_create(void)
+{
+    mlfq_rq_t *rq = malloc(sizeof(mlfq_rq_t));
+
+    assert(rq != NULL);
+    prio_array_init(&rq->levels, mlfq_levels);
+    rq->epoch = 0;
+    return rq;
+}
+
+static void mlfq_enqueue(void *rq, pcb_t *process)
+{
+    mlfq_boost_if_due(rq);
+    prio_array_push(&((mlfq_rq_t *)rq)->levels, process, mlfq_get_level(process));
+}
+
+static pcb_t *mlfq_pick_next(void *rq)
+{
+    mlfq_boost_if_due(rq);
+    return prio_array_pop(&((mlfq_rq_t *)rq)->levels);
+}
+
+static int mlfq_timeslice(const pcb_t *process)
+{
+    return MLFQ_BASE_TIMESLICE << mlfq_get_level(process);
+}
+
+static void mlfq_on_preempt(pcb_t *process, int expired)
+{
+    // It used its whole timeslice, so drop a level
+    if (expired) {
+        unsigned int level = mlfq_get_level(process);
+        mlfq_set_level(process, level + 1 < mlfq_levels ? level + 1 : level);
+    }
+}
+
+static void mlfq_on_yield(pcb_t *process)
+{
+    // It gave up the CPU before its timeslice ran out, so climb a level
+    unsigned int level = mlfq_get_level(process);
+    mlfq_set_level(process, level > 0 ? level - 1 : 0);
+}
+
+
+const sched_policy_t sched_mlfq = {
+    .name = "mlfq",
+    .option = 'm',
+    .arg = "<levels>",
+    .help = "Multilevel Feedback Queue Scheduler with 1-" MLFQ_XSTR(MLFQ_MAX_LEVELS) " levels",
+    .configure = mlfq_configure,
+    .rq_create = mlfq_rq_create,
+    .enqueue = mlfq_enqueue,
+    .pick_next = mlfq_pick_next,
+    .timeslice = mlfq_timeslice,
+    .on_preempt = mlfq_on_preempt,
+    .on_yield = mlfq_on_yield,
+};
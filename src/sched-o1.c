@@ -0,0 +1,112 @@
+/*
+ * sched-o1.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * O(1) priority (-o <time slice>), after the Linux 2.6 scheduler: every
+ * pcb_t::priority (clamped to 0-139, lower is better) has its own FIFO, and
+ * the best non-empty priority is a find-first-set over the occupancy bitmap,
+ * whatever the number of queued processes.  A process whose timeslice runs
+ * out goes to the expired array; when the active array drains, the two are
+ * swapped in O(1).  Processes at the same priority therefore share the CPU
+ * in turn.  Higher priorities preempt lower ones on wake up as in the
+ * priority scheduler.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "prio-array.h"
+#include "sched-policy.h"
+
+
+#define O1_PRIO_LEVELS 140
+
+typedef struct {
+    prio_array_t arrays[2];
+    unsigned int active;        /* index of the active array in arrays[] */
+} o1_rq_t;
+
+static int timeslice;
+
+/* o1_expired[] marks a preempted process for the expired array */
+static int o1_expired[PROCESS_COUNT];
+
+
+static unsigned int o1_priority(const pcb_t *process)
+{
+    if (process->priority < 0) {
+        return 0;
+    }
+    return process->priority < O1_PRIO_LEVELS ? (unsigned int)process->priority : O1_PRIO_LEVELS - 1;
+}
+
+static int o1_configure(const char *arg)
+{
+    timeslice = atoi(arg);
+    return timeslice < 1;
+}
+
+static void *o1_rq_create(void)
+{
+    o1_rq_t *rq = malloc(sizeof(o1_rq_t));
+
+    assert(rq != NULL);
+    prio_array_init(&rq->arrays[0], O1_PRIO_LEVELS);
+    prio_array_init(&rq->arrays[1], O1_PRIO_LEVELS);
+    rq->active = 0;
+    return rq;
+}
+
+static void o1_enqueue(void *queue, pcb_t *process)
+{
+    o1_rq_t *rq = queue;
+    unsigned int array = o1_expired[process->pid] ? !rq->active : rq->active;
+
+    o1_expired[process->pid] = 0;
+    prio_array_push(&rq->arrays[array], process, o1_priority(process));
+}
+
+static pcb_t *o1_pick_next(void *queue)
+{
+    o1_rq_t *rq = queue;
+
+    // Everyone has used their timeslice; start a new round
+    if (prio_array_empty(&rq->arrays[rq->active])) {
+        rq->active = !rq->active;
+    }
+    return prio_array_pop(&rq->arrays[rq->active]);
+}
+
+static int o1_timeslice(const pcb_t *process)
+{
+    (void)process;
+    return timeslice;
+}
+
+static void o1_on_preempt(pcb_t *process, int expired)
+{
+    // It used its whole timeslice, so it waits for the next round
+    if (expired) {
+        o1_expired[process->pid] = 1;
+    }
+}
+
+
+const sched_policy_t sched_o1 = {
+    .name = "o1",
+    .option = 'o',
+    .arg = "<time slice>",
+    .help = "O(1) Priority Scheduler, time slice in tenths of a second",
+    .configure = o1_configure,
+    .init = sched_priority_init,
+    .rq_create = o1_rq_create,
+    .enqueue = o1_enqueue,
+    .pick_next = o1_pick_next,
+    .timeslice = o1_timeslice,
+    .on_preempt = o1_on_preempt,
+    .run = sched_priority_run,
+    .stop = sched_priority_stop,
+    .should_preempt = sched_preempt_lowest_priority,
+};
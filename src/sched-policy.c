@@ -0,0 +1,135 @@
+/*
+ * sched-policy.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Scheduler policy registry.  See sched-policy.h.  To add a policy, write a
+ * sched-<name>.c defining its sched_policy_t, list it below and give it a
+ * sched-<name> target in the Makefile.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "heap.h"
+#include "sched-policy.h"
+
+
+/*
+ * A build specialized for one policy (see student.c) links only that
+ * policy's module, so it is the only one listed.
+ */
+#ifdef SCHED_POLICY
+
+extern const sched_policy_t SCHED_POLICY;
+
+const sched_policy_t *const sched_policies[] = {
+    &SCHED_POLICY,
+    NULL
+};
+
+#else /* SCHED_POLICY */
+
+extern const sched_policy_t sched_fcfs;
+extern const sched_policy_t sched_priority;
+extern const sched_policy_t sched_sjf;
+extern const sched_policy_t sched_rr;
+extern const sched_policy_t sched_mlfq;
+extern const sched_policy_t sched_o1;
+extern const sched_policy_t sched_cfs;
+extern const sched_policy_t sched_aging;
+
+/* The first entry is the default */
+const sched_policy_t *const sched_policies[] = {
+    &sched_fcfs,
+    &sched_priority,
+    &sched_sjf,
+    &sched_rr,
+    &sched_mlfq,
+    &sched_o1,
+    &sched_cfs,
+    &sched_aging,
+    NULL
+};
+
+#endif /* SCHED_POLICY */
+
+
+extern const sched_policy_t *sched_find_option(char option)
+{
+    unsigned int n;
+
+    for (n = 0; sched_policies[n] != NULL; n++) {
+        if (sched_policies[n]->option == option) {
+            return sched_policies[n];
+        }
+    }
+    return NULL;
+}
+
+extern const sched_policy_t *sched_find(const char *name)
+{
+    unsigned int n;
+
+    for (n = 0; sched_policies[n] != NULL; n++) {
+        if (strcmp(sched_policies[n]->name, name) == 0) {
+            return sched_policies[n];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * running_priorities holds the ids of the busy CPUs keyed on the negated
+ * priority of their process, so the CPU running the lowest priority process
+ * is on top, and cpu_count - size is the number of idle CPUs.  It is
+ * protected by running_processes_mutex, as the run() and stop() hooks are.
+ */
+static heap_t running_priorities;
+
+extern void sched_priority_init(void)
+{
+    heap_init(&running_priorities, cpu_count);
+}
+
+extern void sched_priority_run(unsigned int cpu_id, const pcb_t *process)
+{
+    heap_push(&running_priorities, cpu_id, -(long)process->priority);
+}
+
+extern void sched_priority_stop(unsigned int cpu_id, const pcb_t *process)
+{
+    (void)process;
+    if (heap_contains(&running_priorities, cpu_id)) {
+        heap_remove(&running_priorities, cpu_id);
+    }
+}
+
+extern int sched_preempt_lowest_priority(const pcb_t *process, int locked)
+{
+    int lowestPriorityCPU = -1;
+    int lowestPriority = process->priority;
+    unsigned int n;
+
+    if (locked) {
+        /* Never preempt while a CPU is idle */
+        if (running_priorities.size < cpu_count) {
+            return -1;
+        }
+        n = heap_peek(&running_priorities);
+        return -running_priorities.key[n] > lowestPriority ? (int)n : -1;
+    }
+
+    /* running_priorities needs the mutex, so scan running_processes[] */
+    for (n = 0; n < cpu_count; n++) {
+        pcb_t *current = sched_running(n);
+
+        if (current == NULL) {
+            return -1;
+        }
+        if (current->priority > lowestPriority) {
+            lowestPriority = current->priority;
+            lowestPriorityCPU = (int)n;
+        }
+    }
+    return lowestPriorityCPU;
+}
@@ -0,0 +1,112 @@
+/*
+ * sched-policy.h
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Scheduler policy interface.  student.c owns the run queues, their locks,
+ * the wake-up inbox, work stealing and the idle path; everything that
+ * depends on the scheduling policy goes through a sched_policy_t.  Each
+ * policy lives in its own sched-<name>.c and is listed in sched_policies[]
+ * (sched-policy.c), which is where main() finds it by command line option or name.
+ *
+ * A policy keeps whatever per-run-queue structure it likes: rq_create() is
+ * called once per run queue and the pointer it returns is handed back to
+ * enqueue() and pick_next().  Hooks marked optional may be NULL.
+ */
+
+#ifndef __SCHED_POLICY_H__
+#define __SCHED_POLICY_H__
+
+#include "os-sim.h"
+
+
+typedef struct {
+    const char *name;
+    char option;                /* command line flag selecting the policy */
+    const char *arg;            /* name of the flag's argument, or NULL */
+    const char *help;
+
+    /*
+     * Optional: parses the flag's argument, NULL for a policy without one;
+     * returns nonzero if it is bad.  main() may also pass a policy an
+     * option of its own, such as "audit" for FCFS with -a.
+     */
+    int (*configure)(const char *arg);
+
+    /* Optional: called once cpu_count is known, before any rq_create() */
+    void (*init)(void);
+
+    /* Returns the policy's state for one run queue */
+    void *(*rq_create)(void);
+
+    /*
+     * enqueue() adds a READY process to a run queue and pick_next() takes
+     * the next one off it.  pick_next() is only called on a non-empty run
+     * queue.  Both are called with the run queue's lock held.
+     */
+    void (*enqueue)(void *rq, pcb_t *process);
+    pcb_t *(*pick_next)(void *rq);
+
+    /* Optional: ticks the process may run once dispatched; default -1 */
+    int (*timeslice)(const pcb_t *process);
+
+    /*
+     * Optional: process starts or stops running on cpu_id.  Called with
+     * running_processes_mutex held.
+     */
+    void (*run)(unsigned int cpu_id, const pcb_t *process);
+    void (*stop)(unsigned int cpu_id, const pcb_t *process);
+
+    /*
+     * Optional: the running process is being put back on a run queue.
+     * expired is zero when it was force_preempt()ed by wake_up() and
+     * nonzero when its timeslice ran out.
+     */
+    void (*on_preempt)(pcb_t *process, int expired);
+
+    /* Optional: the running process gave up the CPU for I/O */
+    void (*on_yield)(pcb_t *process);
+
+    /* Optional: the process's I/O completed; called before it is queued */
+    void (*on_wake)(pcb_t *process);
+
+    /*
+     * Optional: returns the CPU a waking process should preempt, or -1.
+     * Unless locked is zero, running_processes_mutex is held by the caller;
+     * either way sched_running() may be used to look at the CPUs.
+     */
+    int (*should_preempt)(const pcb_t *process, int locked);
+
+    /* Optional: called at the end of the run */
+    void (*print_stats)(void);
+} sched_policy_t;
+
+
+/* Every policy, terminated by NULL */
+extern const sched_policy_t *const sched_policies[];
+
+/* Return the policy selected by a command line flag or name, or NULL */
+extern const sched_policy_t *sched_find_option(char option);
+extern const sched_policy_t *sched_find(const char *name);
+
+/*
+ * Hooks for static priority policies.  sched_priority_run() and
+ * sched_priority_stop() keep a max-heap of the priorities running on each
+ * CPU, which sched_preempt_lowest_priority() uses as should_preempt() to
+ * find the CPU running the lowest priority process, if it is lower than
+ * process's and no CPU is idle, in O(1).  sched_priority_init() is the
+ * init() hook.
+ */
+extern void sched_priority_init(void);
+extern void sched_priority_run(unsigned int cpu_id, const pcb_t *process);
+extern void sched_priority_stop(unsigned int cpu_id, const pcb_t *process);
+extern int sched_preempt_lowest_priority(const pcb_t *process, int locked);
+
+
+/* Provided by student.c for the policies */
+extern unsigned int cpu_count;
+
+/* sched_running() atomically reads the process running on cpu_id */
+extern pcb_t *sched_running(unsigned int cpu_id);
+
+
+#endif /* __SCHED_POLICY_H__ */
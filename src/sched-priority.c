@@ -0,0 +1,99 @@
+/*
+ * sched-priority.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Static priority scheduling.  READY processes sit in an indexed min-heap
+ * of PIDs keyed on pcb_t::priority (lower is better), so insert and pick
+ * are O(log n); equal priorities come out in the order they became ready.
+ * A waking process preempts the CPU running the lowest priority process,
+ * found in O(1) at the top of a max-heap of the running priorities.
+ *
+ * With aging (-g <ticks>), a READY process gains one level of priority for
+ * every age_ticks it waits, so low priorities cannot starve.  Its effective
+ * priority at time t is priority - (t - enqueued) / age_ticks, and ordering
+ * two processes by that is the same as ordering them by
+ * priority * age_ticks + enqueued, which does not change as t advances.  So
+ * that is the heap key, and nothing needs re-aging tick by tick.  The key
+ * is a long, so aging_configure() turns down an age_ticks large enough to
+ * overflow it for some process at some simulator time.
+ */
+
+#include <limits.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "heap.h"
+#include "sched-policy.h"
+
+
+static long age_ticks;
+
+
+static void *priority_rq_create(void)
+{
+    heap_t *heap = malloc(sizeof(heap_t));
+
+    assert(heap != NULL);
+    heap_init(heap, PROCESS_COUNT);
+    return heap;
+}
+
+static void priority_enqueue(void *rq, pcb_t *process)
+{
+    heap_push(rq, process->pid, process->priority);
+}
+
+static int aging_configure(const char *arg)
+{
+    long max_priority = 1;
+    unsigned int n;
+
+    for (n = 0; n < PROCESS_COUNT; n++) {
+        if (labs((long)processes[n].priority) > max_priority) {
+            max_priority = labs((long)processes[n].priority);
+        }
+    }
+    age_ticks = atol(arg);
+    return age_ticks < 1 || age_ticks > (LONG_MAX - (long)UINT_MAX) / max_priority;
+}
+
+static void aging_enqueue(void *rq, pcb_t *process)
+{
+    heap_push(rq, process->pid, process->priority * age_ticks + (long)get_simulator_time());
+}
+
+static pcb_t *priority_pick_next(void *rq)
+{
+    return &processes[heap_pop(rq)];
+}
+
+
+const sched_policy_t sched_priority = {
+    .name = "priority",
+    .option = 'p',
+    .help = "Priority Scheduler",
+    .init = sched_priority_init,
+    .rq_create = priority_rq_create,
+    .enqueue = priority_enqueue,
+    .pick_next = priority_pick_next,
+    .run = sched_priority_run,
+    .stop = sched_priority_stop,
+    .should_preempt = sched_preempt_lowest_priority,
+};
+
+const sched_policy_t sched_aging = {
+    .name = "aging",
+    .option = 'g',
+    .arg = "<ticks>",
+    .help = "Priority Scheduler, waiting processes gain a level every <ticks>",
+    .configure = aging_configure,
+    .init = sched_priority_init,
+    .rq_create = priority_rq_create,
+    .enqueue = aging_enqueue,
+    .pick_next = priority_pick_next,
+    .run = sched_priority_run,
+    .stop = sched_priority_stop,
+    .should_preempt = sched_preempt_lowest_priority,
+};
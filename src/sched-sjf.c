@@ -0,0 +1,109 @@
+/*
+ * sched-sjf.c
+ * Multithreaded OS Simulation for ECE 3056
+ *
+ * Shortest remaining time first.  READY processes sit in an indexed
+ * min-heap of PIDs keyed on pcb_t::time_remaining.  A waking process
+ * preempts the CPU whose process has the most time remaining, if that is
+ * more than its own.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "heap.h"
+#include "sched-policy.h"
+
+
+/*
+ * running_heap holds the ids of the busy CPUs, with the one whose process
+ * will run longest on top.  Every running process loses one tick of
+ * time_remaining per tick, so ordering them by the time their burst ends
+ * (time_remaining + the time it was dispatched) never goes stale.  Keys
+ * are negated to turn the min-heap into a max-heap.  It is protected by
+ * running_processes_mutex, as the run() and stop() hooks are.
+ */
+static heap_t running_heap;
+
+
+static void sjf_init(void)
+{
+    heap_init(&running_heap, cpu_count);
+}
+
+static void *sjf_rq_create(void)
+{
+    heap_t *heap = malloc(sizeof(heap_t));
+
+    assert(heap != NULL);
+    heap_init(heap, PROCESS_COUNT);
+    return heap;
+}
+
+static void sjf_enqueue(void *rq, pcb_t *process)
+{
+    heap_push(rq, process->pid, process->time_remaining);
+}
+
+static pcb_t *sjf_pick_next(void *rq)
+{
+    return &processes[heap_pop(rq)];
+}
+
+static void sjf_run(unsigned int cpu_id, const pcb_t *process)
+{
+    long burst_end = (long)process->time_remaining + get_simulator_time();
+    heap_push(&running_heap, cpu_id, -burst_end);
+}
+
+static void sjf_stop(unsigned int cpu_id, const pcb_t *process)
+{
+    (void)process;
+    if (heap_contains(&running_heap, cpu_id)) {
+        heap_remove(&running_heap, cpu_id);
+    }
+}
+
+static int sjf_should_preempt(const pcb_t *process, int locked)
+{
+    int longestCPU = -1;
+
+    if (!locked) {
+        // running_heap needs the mutex, so scan for the longest remaining time
+        unsigned int longestRemaining = process->time_remaining;
+        for (unsigned int i = 0; i < cpu_count; i++) {
+            pcb_t *current = sched_running(i);
+            if (current == NULL) {
+                return -1;
+            }
+            if (current->time_remaining > longestRemaining) {
+                longestRemaining = current->time_remaining;
+                longestCPU = (int)i;
+            }
+        }
+    } else if (running_heap.size == cpu_count) {
+        // Every CPU is busy; the top of running_heap finishes last
+        unsigned int top = heap_peek(&running_heap);
+        long longestRemaining = -running_heap.key[top] - (long)get_simulator_time();
+        if (longestRemaining > (long)process->time_remaining) {
+            longestCPU = (int)top;
+        }
+    }
+    return longestCPU;
+}
+
+
+const sched_policy_t sched_sjf = {
+    .name = "sjf",
+    .option = 's',
+    .help = "Shortest Remaining Time First Scheduler",
+    .init = sjf_init,
+    .rq_create = sjf_rq_create,
+    .enqueue = sjf_enqueue,
+    .pick_next = sjf_pick_next,
+    .run = sjf_run,
+    .stop = sjf_stop,
+    .should_preempt = sjf_should_preempt,
+};
@@ -13,24 +13,20 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
+#include "lockstat.h"
 #include "os-sim.h"
-/* Define which scheduler we are using.
- * FCFS = 0
- * Priority Queue = 1
- * SJF = 2
- */
-
-#define FCFS 0
-#define PRIORITYQ 1
-#define SJF 2
-
+#include "process.h"
+#include "sched-policy.h"
+#include "student.h"
 /** Function prototypes **/
 extern void idle(unsigned int cpu_id);
 extern void preempt(unsigned int cpu_id);
 extern void yield(unsigned int cpu_id);
 extern void terminate(unsigned int cpu_id);
 extern void wake_up(pcb_t *process);
+extern void wake_up_batch(pcb_t **batch, unsigned int count);
 
 
 /*
@@ -42,16 +38,357 @@ extern void wake_up(pcb_t *process);
  * will need to use a mutex to protect it.  running_processes_mutex has been provided
  * for your use.
  */
-static pcb_t *readyQHead;
 static pcb_t **running_processes;
-static pcb_t *FCFSqueue;
 static pthread_mutex_t running_processes_mutex;
+static lockstat_t running_processes_stats;     /* -c, see lockstat.h */
+
+/*
+ * A run queue holds READY processes.  By default there is a single run queue
+ * shared by every CPU; with -l each CPU owns one, wake_up() places work on
+ * the CPU the process last ran on or the least loaded one, and a CPU whose
+ * queue is empty steals from the busiest queue before going idle.
+ *
+ * What is inside a run queue is up to the scheduling policy (see
+ * sched-policy.h): queue is whatever the policy's rq_create() returned, and
+ * processes go in and out through its enqueue() and pick_next() hooks.
+ *
+ * With -i, wake_up() does not take the run queue lock at all.  It pushes
+ * the PCB onto the run queue's inbox, a lock-free multi-producer stack
+ * linked through pcb_t::next, and whoever next locks the run queue to pick
+ * detaches the whole stack with one atomic exchange and queues it in
+ * arrival order.
+ *
+ * Everything in a run queue is protected by its mutex, except nr_queued and
+ * nr_inbox, which are also read without the lock to pick placement and
+ * steal targets, and inbox, which is only touched atomically.
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    lockstat_t stats;
+    void *queue;
+    unsigned int nr_queued;
+    pcb_t *inbox;
+    unsigned int nr_inbox;
+    unsigned long inbox_drains;
+    unsigned long inbox_drained;
+} runqueue_t;
+
+static runqueue_t *runqueues;
+static unsigned int nr_runqueues;
+static int per_cpu_queues;
+static int use_inbox;
+
+/* -d: the simulator runs us inline, so idle() must never wait */
+static int idle_returns;
+
+/*
+ * Affinity (-M <ticks>): a process that stopped running less than
+ * migration_cost ticks ago is cache-hot, and wake_up() sends it back to
+ * pcb_t::last_cpu unless that CPU has more than AFFINITY_IMBALANCE units
+ * of work beyond the least loaded one.  last_stop[] is the tick each
+ * process last left a CPU; with -i, place() reads it without any lock.
+ */
+#define AFFINITY_IMBALANCE 1
+
+static unsigned int migration_cost;
+static unsigned int last_stop[PROCESS_COUNT];
+
+/*
+ * Idle CPUs.  A CPU with nothing to run sets its bit in idle_mask and
+ * sleeps in idle_wait() until an enqueuer claims it by clearing the bit,
+ * then calls idle_kick() (see os-sim.h).  Every process queued claims at most
+ * one idle CPU, preferring the one that owns the run queue, so as many
+ * CPUs wake as there is new work and no more.  nr_ready counts the
+ * processes queued across all run queues.  A CPU re-reads it after setting
+ * its bit and an enqueuer reads the mask after adding to it, so either the
+ * enqueuer sees the CPU or the CPU sees the work.  nr_picked counts the
+ * processes taken off a run queue and not yet dispatched, which are still
+ * READY as far as processes_ready() is concerned.
+ */
+#define IDLE_MASK_BITS (8 * sizeof(unsigned long))
+
+static unsigned long *idle_mask;
+static unsigned int idle_mask_words;
+static unsigned int nr_ready;
+static unsigned int nr_picked;
+
+/*
+ * preempt_forced[cpu] is set by wake_up() before it calls force_preempt(),
+ * so preempt() can tell a forced preemption from an expired timeslice.  If
+ * force_preempt() finds nothing to preempt, wake_up() clears it again, so
+ * the next process's real expiry is not mistaken for a forced one.
+ */
+static int *preempt_forced;
 
-static pthread_mutex_t queue_mutex;
-static pthread_cond_t queue_not_empty;
 unsigned int cpu_count;
-unsigned int scheduler_type;
 
+/*
+ * The policy selected on the command line.  A build specialized for one
+ * policy (make sched-<name>, which defines SCHED_POLICY as the name of its
+ * sched_policy_t) refers to that object directly instead; it is const, so
+ * with link-time optimization every call through it becomes a direct call
+ * and the hooks the policy leaves NULL disappear.
+ */
+#ifdef SCHED_POLICY
+extern const sched_policy_t SCHED_POLICY;
+#define policy (&SCHED_POLICY)
+#else
+static const sched_policy_t *policy;
+#endif
+
+
+static runqueue_t *cpu_runqueue(unsigned int cpu_id)
+{
+    return &runqueues[per_cpu_queues ? cpu_id : 0];
+}
+
+static void rq_lock(runqueue_t *rq)
+{
+    lockstat_lock(&rq->stats, &rq->mutex);
+}
+
+static void rq_unlock(runqueue_t *rq)
+{
+    lockstat_unlock(&rq->stats, &rq->mutex);
+}
+
+static unsigned int rq_load(const runqueue_t *rq)
+{
+    return __atomic_load_n(&rq->nr_queued, __ATOMIC_RELAXED)
+        + __atomic_load_n(&rq->nr_inbox, __ATOMIC_RELAXED);
+}
+
+/*
+ * rq_push() and rq_pop() add and take READY processes through the policy
+ * and keep nr_queued up to date.  rq->mutex must be held by the caller.
+ */
+static void rq_push(runqueue_t *rq, pcb_t *process)
+{
+    policy->enqueue(rq->queue, process);
+    __atomic_store_n(&rq->nr_queued, rq->nr_queued + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Moves everything pushed onto rq's inbox into the run queue proper.
+ * rq->mutex must be held by the caller, which makes it the single consumer.
+ */
+static void inbox_drain(runqueue_t *rq)
+{
+    pcb_t *batch, *arrivals = NULL, *process;
+    unsigned int count = 0;
+
+    if (__atomic_load_n(&rq->inbox, __ATOMIC_RELAXED) == NULL) {
+        return;
+    }
+    batch = __atomic_exchange_n(&rq->inbox, NULL, __ATOMIC_ACQUIRE);
+
+    // The inbox is a stack; reverse it so the batch is queued in arrival order
+    while (batch != NULL) {
+        process = batch;
+        batch = batch->next;
+        process->next = arrivals;
+        arrivals = process;
+        count++;
+    }
+    while (arrivals != NULL) {
+        process = arrivals;
+        arrivals = arrivals->next;
+        rq_push(rq, process);
+    }
+    __atomic_sub_fetch(&rq->nr_inbox, count, __ATOMIC_RELAXED);
+    rq->inbox_drains++;
+    rq->inbox_drained += count;
+}
+
+static pcb_t *rq_pop(runqueue_t *rq)
+{
+    pcb_t *selectedProcess;
+
+    if (use_inbox) {
+        inbox_drain(rq);
+    }
+    if (rq->nr_queued == 0) {
+        return NULL;
+    }
+    selectedProcess = policy->pick_next(rq->queue);
+    __atomic_store_n(&rq->nr_queued, rq->nr_queued - 1, __ATOMIC_RELAXED);
+    // Counted as picked before it stops counting as queued, so processes_ready() never dips
+    __atomic_add_fetch(&nr_picked, 1, __ATOMIC_SEQ_CST);
+    __atomic_sub_fetch(&nr_ready, 1, __ATOMIC_SEQ_CST);
+    return selectedProcess;
+}
+
+
+static void idle_mask_set(unsigned int cpu_id)
+{
+    __atomic_or_fetch(&idle_mask[cpu_id / IDLE_MASK_BITS], 1ul << (cpu_id % IDLE_MASK_BITS),
+        __ATOMIC_SEQ_CST);
+}
+
+/* Clears cpu_id's idle bit; returns nonzero if this call is the one that did */
+static int idle_mask_claim(unsigned int cpu_id)
+{
+    unsigned long bit = 1ul << (cpu_id % IDLE_MASK_BITS);
+    return (__atomic_fetch_and(&idle_mask[cpu_id / IDLE_MASK_BITS], ~bit, __ATOMIC_SEQ_CST) & bit) != 0;
+}
+
+
+/*
+ * Wakes up to count CPUs sleeping in idle() for work just queued on rq,
+ * starting with the CPU that owns rq.  nr_ready must already include it.
+ */
+static void notify_idle(const runqueue_t *rq, unsigned int count)
+{
+    unsigned int owner = (unsigned int)(rq - runqueues), word, cpu_id;
+    unsigned long bits;
+
+    if (per_cpu_queues && count > 0 && idle_mask_claim(owner)) {
+        idle_kick(owner);
+        count--;
+    }
+    for (word = 0; word < idle_mask_words && count > 0; word++) {
+        while (count > 0 && (bits = __atomic_load_n(&idle_mask[word], __ATOMIC_SEQ_CST)) != 0) {
+            cpu_id = word * (unsigned int)IDLE_MASK_BITS + (unsigned int)__builtin_ctzl(bits);
+            if (idle_mask_claim(cpu_id)) {
+                idle_kick(cpu_id);
+                count--;
+            }
+        }
+    }
+}
+
+/*
+ * requeue() makes a preempted process READY on run queue rq without waking
+ * an idle CPU for it: the preempting CPU picks again straight away, and
+ * only wakes one for whatever its pick leaves behind.
+ */
+static void requeue(runqueue_t *rq, pcb_t *process)
+{
+    rq_lock(rq);
+    set_process_state(process, PROCESS_READY);
+    rq_push(rq, process);
+    __atomic_add_fetch(&nr_ready, 1, __ATOMIC_SEQ_CST);
+    rq_unlock(rq);
+}
+
+/*
+ * inbox_push() is enqueue() without the run queue lock: the count processes
+ * chained through pcb_t::next from first to last are pushed onto rq's inbox
+ * with one compare-and-swap and picked up by the next inbox_drain().  The
+ * inbox is a stack, so the chain runs from the newest process to the oldest.
+ *
+ * The counts go up before the chain is published: once it is, a drain and
+ * a pop may take it and subtract at any moment, and the unsigned counters
+ * must not go below zero first.
+ */
+static void inbox_push(runqueue_t *rq, pcb_t *first, pcb_t *last, unsigned int count)
+{
+    pcb_t *head = __atomic_load_n(&rq->inbox, __ATOMIC_RELAXED);
+
+    __atomic_add_fetch(&rq->nr_inbox, count, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&nr_ready, count, __ATOMIC_SEQ_CST);
+    do {
+        last->next = head;
+    } while (!__atomic_compare_exchange_n(&rq->inbox, &head, first, 1,
+        __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+    notify_idle(rq, count);
+}
+
+/*
+ * Steals a process from the most loaded run queue other than cpu_id's.
+ * Queue lengths are read without locks, so a victim may have been emptied
+ * by the time we lock it; then the next busiest queue is tried.
+ */
+static pcb_t *steal(unsigned int cpu_id)
+{
+    unsigned int n, tries, victim, victim_load;
+    pcb_t *process;
+
+    for (tries = 0; tries < nr_runqueues; tries++) {
+        victim = cpu_id;
+        victim_load = 0;
+        for (n = 0; n < nr_runqueues; n++) {
+            if (n != cpu_id && rq_load(&runqueues[n]) > victim_load) {
+                victim = n;
+                victim_load = rq_load(&runqueues[n]);
+            }
+        }
+        if (victim == cpu_id) {
+            return NULL;
+        }
+        rq_lock(&runqueues[victim]);
+        process = rq_pop(&runqueues[victim]);
+        rq_unlock(&runqueues[victim]);
+        if (process != NULL) {
+            return process;
+        }
+    }
+    return NULL;
+}
+
+/* Takes the next process for cpu_id off its run queue, or steals one */
+static pcb_t *pick_next(unsigned int cpu_id)
+{
+    runqueue_t *rq = cpu_runqueue(cpu_id);
+    pcb_t *process;
+
+    rq_lock(rq);
+    process = rq_pop(rq);
+    rq_unlock(rq);
+
+    if (process == NULL && per_cpu_queues) {
+        process = steal(cpu_id);
+    }
+    return process;
+}
+
+
+/*
+ * Takes the process off cpu_id in running_processes[].
+ */
+static pcb_t *clear_running(unsigned int cpu_id)
+{
+    pcb_t *process;
+
+    lockstat_lock(&running_processes_stats, &running_processes_mutex);
+    process = running_processes[cpu_id];
+    __atomic_store_n(&running_processes[cpu_id], NULL, __ATOMIC_RELEASE);
+    if (process != NULL) {
+        __atomic_store_n(&last_stop[process->pid], get_simulator_time(), __ATOMIC_RELAXED);
+    }
+    if (process != NULL && policy->stop != NULL) {
+        policy->stop(cpu_id, process);
+    }
+    lockstat_unlock(&running_processes_stats, &running_processes_mutex);
+    return process;
+}
+
+
+/*
+ * Runs selectedProcess (or the idle process, for NULL) on cpu_id.
+ */
+static void dispatch(unsigned int cpu_id, pcb_t *selectedProcess)
+{
+    int selectedTimeslice = -1;
+
+    lockstat_lock(&running_processes_stats, &running_processes_mutex);
+    if (selectedProcess != NULL) {
+        if (policy->timeslice != NULL) {
+            selectedTimeslice = policy->timeslice(selectedProcess);
+        }
+        set_process_state(selectedProcess, PROCESS_RUNNING);
+        __atomic_store_n(&running_processes[cpu_id], selectedProcess, __ATOMIC_RELEASE);
+        if (policy->run != NULL) {
+            policy->run(cpu_id, selectedProcess);
+        }
+    }
+    context_switch(cpu_id, selectedProcess, selectedTimeslice);
+    lockstat_unlock(&running_processes_stats, &running_processes_mutex);
+    if (selectedProcess != NULL) {
+        __atomic_sub_fetch(&nr_picked, 1, __ATOMIC_SEQ_CST);
+    }
+}
 
 
 /*
@@ -72,113 +409,7 @@ unsigned int scheduler_type;
  */
 static void schedule(unsigned int cpu_id)
 {
-	pthread_mutex_lock(&queue_mutex);
-    pthread_mutex_lock(&running_processes_mutex);
-    pcb_t *readyQIterator = readyQHead;
-    pcb_t *selectedProcess = readyQHead;
-
-    /*
-    // lets test the ready queue before schedule
-    pcb_t * prev = NULL;
-    pcb_t *iter = readyQHead;
-    printf("Schedule!!\n");
-    while(iter!=NULL){
-        printf("Name: %s, PID: %d, Priority: %d\n", iter->name, iter->pid, iter->priority);
-        iter = iter->next;
-    }*/
-
-    /* ============================================================FCFS============================================= */
-    if(scheduler_type == FCFS) {
-        if (readyQIterator != NULL) {
-            unsigned int min_PID = readyQIterator->pid;
-            // This finds the min_PID in the queue
-            while(readyQIterator != NULL){
-                if(readyQIterator->pid < min_PID){ min_PID = readyQIterator->pid; }
-                readyQIterator= readyQIterator->next;
-            }
-            // This finds the node before min_PID in the queue
-            readyQIterator = readyQHead;
-            while(readyQIterator->next != NULL) {
-                if((readyQIterator->next)->pid == min_PID) {
-                    break;
-                }
-                readyQIterator = readyQIterator->next;
-            }
-            //If there is only one value in readyQ
-            if(readyQHead->next == NULL){
-                selectedProcess->state = PROCESS_RUNNING;
-                running_processes[cpu_id] = selectedProcess;
-                readyQHead = NULL;
-            } else {
-                // If the selectedProcess is the head but there is another value
-                if(readyQHead->pid == min_PID){
-                    selectedProcess = readyQHead;
-                    readyQHead = readyQHead->next;
-                    selectedProcess->next = NULL;
-                    selectedProcess->state = PROCESS_RUNNING;
-                    running_processes[cpu_id] = selectedProcess;
-                } else {
-                    selectedProcess = (readyQIterator->next);
-                    // Set node before min_PID's next to selectedProcesses's next
-                    readyQIterator->next = selectedProcess->next;
-                    selectedProcess->next = NULL;
-                    selectedProcess->state = PROCESS_RUNNING;
-                    running_processes[cpu_id] = selectedProcess;
-                }
-            }
-        }
-    }
-    /* ======================================================PRIORITY=============================================== */
-    else if (scheduler_type == PRIORITYQ){
-        if (readyQIterator != NULL) {
-            int max_Priority = readyQIterator->priority;
-            // This finds the max_Priority in the queue
-            while(readyQIterator != NULL){
-                if(readyQIterator->priority < max_Priority){ max_Priority = readyQIterator->priority; }
-                readyQIterator= readyQIterator->next;
-            }
-            // This finds the node before max_Priority in the queue
-            readyQIterator = readyQHead;
-            while(readyQIterator->next != NULL) {
-                if((readyQIterator->next)->priority == max_Priority) {
-                    break;
-                }
-                readyQIterator = readyQIterator->next;
-            }
-            //If there is only one value in readyQ
-            if(readyQHead->next == NULL){
-                selectedProcess->state = PROCESS_RUNNING;
-                running_processes[cpu_id] = selectedProcess;
-                readyQHead = NULL;
-            } else {
-                // If the selectedProcess is the head but there is another value
-                if(readyQHead->priority == max_Priority){
-                    selectedProcess = readyQHead;
-                    readyQHead = readyQHead->next;
-                    selectedProcess->next = NULL;
-                    selectedProcess->state = PROCESS_RUNNING;
-                    running_processes[cpu_id] = selectedProcess;
-                } else {
-                    selectedProcess = (readyQIterator->next);
-                    // Set node before min_PID's next to selectedProcesses's next
-                    readyQIterator->next = selectedProcess->next;
-                    selectedProcess->next = NULL;
-                    selectedProcess->state = PROCESS_RUNNING;
-                    running_processes[cpu_id] = selectedProcess;
-                }
-            }
-        }
-    }
-    /* =======================SJF======================
-    else if (scheduler_type == SJF){
-
-
-    }*/ else {
-        printf("Incorrect type.");
-    }
-    context_switch(cpu_id, selectedProcess);
-    pthread_mutex_unlock(&running_processes_mutex);
-	pthread_mutex_unlock(&queue_mutex);
+    dispatch(cpu_id, pick_next(cpu_id));
 }
 
 
@@ -191,52 +422,50 @@ static void schedule(unsigned int cpu_id)
  */
 extern void idle(unsigned int cpu_id)
 {
-    pthread_mutex_lock(&queue_mutex);
-    while(readyQHead == NULL){
-        pthread_cond_wait(&queue_not_empty, &queue_mutex);
+    pcb_t *selectedProcess;
+
+    // Another CPU may take the work we were woken for, so keep waiting until we get some
+    while ((selectedProcess = pick_next(cpu_id)) == NULL) {
+        // Inline, the simulator calls us again when work may have arrived
+        if (idle_returns) {
+            return;
+        }
+        idle_mask_set(cpu_id);
+        // Work was queued since we looked: take our bit back, unless someone already claimed us
+        if (__atomic_load_n(&nr_ready, __ATOMIC_SEQ_CST) > 0 && idle_mask_claim(cpu_id)) {
+            continue;
+        }
+        idle_wait(cpu_id);
     }
-    pthread_mutex_unlock(&queue_mutex);
-    schedule(cpu_id);
+    dispatch(cpu_id, selectedProcess);
 }
 
 
 /*
  * preempt() is the handler called by the simulator when a process is
- * preempted 
+ * preempted
  *
  * This function should place the currently running process back in the
  * ready queue, and call schedule() to select a new runnable process.
  */
 extern void preempt(unsigned int cpu_id)
 {
-    // Lock the queue & running processes
+    runqueue_t *rq = cpu_runqueue(cpu_id);
+    pcb_t *selectedProcess;
     // Take process out of running_processes
-    pcb_t *preemptedProcess = running_processes[cpu_id];
-    running_processes[cpu_id] = NULL;
-    // Mark the process as ready
-    preemptedProcess->state = PROCESS_READY;
-    // If the readyQ is empty preempt should trigger queue_not_empty
-    if (readyQHead == NULL) {
-        readyQHead = preemptedProcess;
-        pthread_cond_signal(&queue_not_empty);
-    } else {
-        // Linked List that adds to the beginning
-        // Insert into ready queue [new process] -> [old process]
-        preemptedProcess->next = readyQHead;
-        readyQHead = preemptedProcess;
+    pcb_t *preemptedProcess = clear_running(cpu_id);
+    int expired = !__atomic_exchange_n(&preempt_forced[cpu_id], 0, __ATOMIC_ACQ_REL);
+    if (policy->on_preempt != NULL) {
+        policy->on_preempt(preemptedProcess, expired);
     }
-
-    /*
-    //Lets test ready queue after preempt
-    pcb_t *iter = readyQHead;
-    printf("Preempt!!\n");
-    while(iter!=NULL){ printf("Name: %s, PID: %d, Priority: %d\n", iter->name, iter->pid, iter->priority);iter = iter->next;}
-     */
-
-    // Unlock the queue & running processes
-    pthread_mutex_unlock(&running_processes_mutex);
-    pthread_mutex_unlock(&queue_mutex);
-    schedule(cpu_id);
+    // Mark the process as ready, back on this CPU's queue
+    requeue(rq, preemptedProcess);
+    selectedProcess = pick_next(cpu_id);
+    // An idle CPU is only worth waking for work our pick left behind
+    if (rq_load(rq) > 0) {
+        notify_idle(rq, 1);
+    }
+    dispatch(cpu_id, selectedProcess);
 }
 
 
@@ -249,14 +478,11 @@ extern void preempt(unsigned int cpu_id)
  */
 extern void yield(unsigned int cpu_id)
 {
-    // Same comments as terminate
-    pthread_mutex_lock(&queue_mutex);
-    pthread_mutex_lock(&running_processes_mutex);
-    pcb_t *currentProcess = running_processes[cpu_id];
-    currentProcess->state = PROCESS_WAITING;
-    running_processes[cpu_id] = NULL;
-    pthread_mutex_unlock(&running_processes_mutex);
-    pthread_mutex_unlock(&queue_mutex);
+    pcb_t *currentProcess = clear_running(cpu_id);
+    set_process_state(currentProcess, PROCESS_WAITING);
+    if (policy->on_yield != NULL) {
+        policy->on_yield(currentProcess);
+    }
     schedule(cpu_id);
 }
 
@@ -268,25 +494,80 @@ extern void yield(unsigned int cpu_id)
  */
 extern void terminate(unsigned int cpu_id)
 {
-    // Lock the running processes
-    pthread_mutex_lock(&queue_mutex);
-    pthread_mutex_lock(&running_processes_mutex);
     // Get the process currently running
-	pcb_t *currentProcess = running_processes[cpu_id];
+	pcb_t *currentProcess = clear_running(cpu_id);
 	// Set the state as finished
-	currentProcess->state = PROCESS_TERMINATED;
-	running_processes[cpu_id] = NULL;
-	// Unlock the running processes
-	/*
-	printf("TERMINATED");
-	printf(currentProcess->name);
-	 */
-    pthread_mutex_unlock(&running_processes_mutex);
-    pthread_mutex_unlock(&queue_mutex);
+	set_process_state(currentProcess, PROCESS_TERMINATED);
     // Call schedule() to select new process
 	schedule(cpu_id);
 }
 
+
+/*
+ * sched_running() reads running_processes[cpu_id].  Writers update it with
+ * atomic stores under running_processes_mutex, so with -i wake_up() and the
+ * policies' should_preempt() hooks can read it without taking the mutex.
+ */
+extern pcb_t *sched_running(unsigned int cpu_id)
+{
+    return __atomic_load_n(&running_processes[cpu_id], __ATOMIC_ACQUIRE);
+}
+
+extern unsigned int processes_ready(void)
+{
+    return __atomic_load_n(&nr_ready, __ATOMIC_SEQ_CST) + __atomic_load_n(&nr_picked, __ATOMIC_SEQ_CST);
+}
+
+static unsigned int cpu_load(unsigned int cpu_id)
+{
+    return rq_load(&runqueues[cpu_id]) + (sched_running(cpu_id) != NULL);
+}
+
+/*
+ * Chooses the run queue for a process that is becoming ready: the least
+ * loaded CPU, counting a busy CPU as one unit of work and preferring the
+ * CPU the process last ran on.  When no CPU is idle, a cache-hot process
+ * stays on its last CPU if that is within AFFINITY_IMBALANCE of the best.
+ */
+static runqueue_t *place(const pcb_t *process)
+{
+    int last_cpu = __atomic_load_n(&process->last_cpu, __ATOMIC_RELAXED);
+    unsigned int n, best, load, best_load;
+
+    if (!per_cpu_queues) {
+        return &runqueues[0];
+    }
+    best = last_cpu >= 0 ? (unsigned int)last_cpu : 0;
+    best_load = cpu_load(best);
+    for (n = 0; n < cpu_count && best_load > 0; n++) {
+        load = cpu_load(n);
+        if (load < best_load) {
+            best = n;
+            best_load = load;
+        }
+    }
+    // An idle CPU would steal it straight back, so only hold out for a busy one
+    if (last_cpu >= 0 && (unsigned int)last_cpu != best && best_load > 0
+            && get_simulator_time() - __atomic_load_n(&last_stop[process->pid], __ATOMIC_RELAXED)
+                < migration_cost
+            && cpu_load((unsigned int)last_cpu) <= best_load + AFFINITY_IMBALANCE) {
+        best = (unsigned int)last_cpu;
+    }
+    return &runqueues[best];
+}
+
+/*
+ * Returns the CPU that process should preempt when it becomes ready, or -1.
+ * Unless inbox is set, running_processes_mutex must be held by the caller.
+ */
+static int find_victim(const pcb_t *process, int inbox)
+{
+    if (policy->should_preempt == NULL) {
+        return -1;
+    }
+    return policy->should_preempt(process, !inbox);
+}
+
 /*
  * wake_up() is the handler called by t he simulator when a process's I/O
  * request completes.  It should perform the following tasks:
@@ -298,99 +579,322 @@ extern void terminate(unsigned int cpu_id)
  *      execute the process which just woke up.  However, if any CPU is
  *      currently running idle, or all of the CPUs are running processes
  *      with a higher priority than the one which just woke up, wake_up()
- *      should not preempt any CPUs.
+ *      should not preempt any CPUs.  Which CPU, if any, to preempt is
+ *      up to the policy's should_preempt() hook.
  *  To preempt a process, use force_preempt(). Look in os-sim.h for
  *  its prototype and the parameters it takes in.
+ *
+ *  With per-CPU run queues, a process that preempts a CPU is queued on that
+ *  CPU so its preempt() handler picks it up.  With -i, wake_up() takes no
+ *  scheduler locks: it reads running_processes[] atomically and pushes the
+ *  process onto the chosen run queue's inbox.
  */
 extern void wake_up(pcb_t *process)
 {
-    pthread_mutex_lock(&queue_mutex);
-    pthread_mutex_lock(&running_processes_mutex);
-    // IF SOMETHING IN QUEUE
-    if(readyQHead != NULL) {
-        // Linked List that adds to the beginning
-        // Mark the process as ready
-        process->state = PROCESS_READY;
-        // Insert into ready queue [new process] -> [old process]
-        process->next = readyQHead;
-        readyQHead = process;
-    } else {
-        // Mark the process as ready
-        process->state = PROCESS_READY;
-        // Insert into ready queue readyQHead -> [new process]
-        readyQHead = process;
-        pthread_cond_signal(&queue_not_empty);
-    }
-
-    //Lets test ready queue after wake up
-    /*
-    pcb_t* iter = readyQHead;
-    printf("Wakeup!!\n");
-    while(iter!=NULL){printf("Name: %s, PID: %d, Priority: %d\n", iter->name, iter->pid, iter->priority);iter = iter->next;}
-    */
-
-    if(scheduler_type == PRIORITYQ) {
-        int noFreeCPU = 1;
-        int lowestPriority = process->priority;
-        int lowestPriorityCPU = -1;
-        for (int i = 0; i < cpu_count; i++) {
-            // If any of the running processes are NULL then there is a Free CPU
-            if (running_processes[i] == NULL) {
-                noFreeCPU = 0;
+    wake_up_batch(&process, 1);
+}
+
+/* Preempts cpu_id for a process that has just been queued */
+static void preempt_for_wake_up(int cpu_id)
+{
+    __atomic_store_n(&preempt_forced[cpu_id], 1, __ATOMIC_RELEASE);
+    if (!force_preempt((unsigned int)cpu_id)) {
+        __atomic_store_n(&preempt_forced[cpu_id], 0, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * wake_up_batch() is wake_up() for every process that became ready in the
+ * same tick.  Victims and run queues are chosen for the whole batch under
+ * one hold of running_processes_mutex, and each run queue is locked (or
+ * its inbox swung) once however many of the batch go to it.
+ *
+ * Two processes in a batch may pick the same victim.  The first preempts
+ * it; the later ones are queued, and once the first round of preemptions
+ * has completed, each one still READY looks for a victim again, as it
+ * would have if it had been woken on its own.
+ */
+#define VICTIM_RETRY -2
+
+extern void wake_up_batch(pcb_t **batch, unsigned int count)
+{
+    int victim[PROCESS_COUNT];
+    runqueue_t *rq[PROCESS_COUNT];
+    int queued[PROCESS_COUNT] = { 0 };
+    unsigned int i, j, n;
+
+    assert(count <= PROCESS_COUNT);
+    for (i = 0; i < count; i++) {
+        if (policy->on_wake != NULL) {
+            policy->on_wake(batch[i]);
+        }
+    }
+
+    if (!use_inbox) {
+        lockstat_lock(&running_processes_stats, &running_processes_mutex);
+    }
+    for (i = 0; i < count; i++) {
+        victim[i] = find_victim(batch[i], use_inbox);
+        for (j = 0; j < i && victim[i] >= 0; j++) {
+            if (victim[j] == victim[i]) {
+                victim[i] = VICTIM_RETRY;
+            }
+        }
+        rq[i] = victim[i] >= 0 ? cpu_runqueue((unsigned int)victim[i]) : place(batch[i]);
+    }
+    if (!use_inbox) {
+        lockstat_unlock(&running_processes_stats, &running_processes_mutex);
+    }
+
+    // Mark the processes as ready and insert them, one run queue at a time
+    for (i = 0; i < count; i++) {
+        pcb_t *first = NULL, *last = batch[i];
+
+        if (queued[i]) {
+            continue;
+        }
+        n = 0;
+        if (!use_inbox) {
+            rq_lock(rq[i]);
+        }
+        for (j = i; j < count; j++) {
+            if (rq[j] != rq[i]) {
+                continue;
+            }
+            queued[j] = 1;
+            set_process_state(batch[j], PROCESS_READY);
+            if (use_inbox) {
+                batch[j]->next = first;
+                first = batch[j];
             } else {
-                // Run through the running processes to find the lowest priority
-                if ((running_processes[i])->priority > lowestPriority) {
-                    lowestPriority = (running_processes[i])->priority;
-                    lowestPriorityCPU = i;
-                }
+                rq_push(rq[i], batch[j]);
             }
+            n++;
         }
-        // If there are no free CPU's and the lowest priority is less than the new process's then preempt
-        if (noFreeCPU == 1 && lowestPriority > process->priority) {
-            force_preempt(lowestPriorityCPU);
+        if (use_inbox) {
+            inbox_push(rq[i], first, last, n);
+        } else {
+            __atomic_add_fetch(&nr_ready, n, __ATOMIC_SEQ_CST);
+            rq_unlock(rq[i]);
+            notify_idle(rq[i], n);
         }
     }
 
+    /*
+     * force_preempt() waits for preempt() to run on the victim CPU, and
+     * preempt() takes our locks, so they must be released first.
+     */
+    for (i = 0; i < count; i++) {
+        if (victim[i] >= 0) {
+            preempt_for_wake_up(victim[i]);
+        }
+    }
+    for (i = 0; i < count; i++) {
+        if (victim[i] == VICTIM_RETRY
+                && __atomic_load_n(&batch[i]->state, __ATOMIC_RELAXED) == PROCESS_READY) {
+            int retry;
+            if (!use_inbox) {
+                lockstat_lock(&running_processes_stats, &running_processes_mutex);
+            }
+            retry = find_victim(batch[i], use_inbox);
+            if (!use_inbox) {
+                lockstat_unlock(&running_processes_stats, &running_processes_mutex);
+            }
+            if (retry >= 0) {
+                preempt_for_wake_up(retry);
+            }
+        }
+    }
+}
 
-    pthread_mutex_unlock(&running_processes_mutex);
-    pthread_mutex_unlock(&queue_mutex);
+
+/*
+ * print_scheduler_stats() is called by the simulator after it prints its own
+ * statistics at the end of the run.
+ */
+extern void print_scheduler_stats(void)
+{
+    if (policy->print_stats != NULL) {
+        policy->print_stats();
+    }
+    if (use_inbox) {
+        unsigned long drains = 0, drained = 0;
+        for (unsigned int n = 0; n < nr_runqueues; n++) {
+            drains += runqueues[n].inbox_drains;
+            drained += runqueues[n].inbox_drained;
+        }
+        printf("Wake-up inbox: %lu processes in %lu batches (%.2f per batch)\n", drained, drains,
+            drains > 0 ? (double)drained / (double)drains : 0.0);
+    }
+}
+
+
+static void usage(const char *program)
+{
+    const sched_policy_t *const *p;
+
+    fprintf(stderr, "Multithreaded OS Simulator\n"
+        "Usage: %s [<policy> | -P <name>[=<arg>]] [-l [-M <ticks>]] [-i] [-a] [-c] [-e] [-u] [-d | -k | -b] <# CPUs>\n"
+        "    Default : %s\n", program, sched_policies[0]->help);
+    for (p = sched_policies; *p != NULL; p++) {
+        fprintf(stderr, "  -%c %-13s: %s (%s)\n", (*p)->option,
+            (*p)->arg != NULL ? (*p)->arg : "", (*p)->help, (*p)->name);
+    }
+    fprintf(stderr,
+        "  -P <name>       : Select a policy by name, with its argument after '='\n"
+        "  -l              : Give each CPU its own run queue, with work stealing\n"
+        "  -M <ticks>      : With -l, keep processes that ran within <ticks> on their last CPU\n"
+        "  -i              : Hand woken processes to the scheduler through a lock-free inbox\n"
+        "  -a              : With FCFS, count picks where arrival order and lowest-PID order disagree\n"
+        "  -c              : Report lock contention and hold times per lock and thread\n"
+        "  -e              : Event-driven: skip ticks in which nothing can happen\n"
+        "  -u              : Unthrottled: no sleep between ticks, wait for the CPUs to settle\n"
+        "  -d              : Deterministic: run every handler inline on one thread\n"
+        "  -k              : Run each CPU as a coroutine instead of a thread\n"
+        "  -b              : Hand out each tick's CPU events at once and run the handlers in parallel\n\n");
+    exit(-1);
+}
+
+/* Selects new_policy, or prints the usage if it is unknown or arg is bad */
+static int policy_configured;
+
+static void select_policy(const char *program, const sched_policy_t *new_policy, const char *arg)
+{
+    if (new_policy == NULL || (new_policy->arg != NULL) != (arg != NULL)) {
+        usage(program);
+    }
+    if (new_policy->configure != NULL && new_policy->configure(arg)) {
+        usage(program);
+    }
+#ifndef SCHED_POLICY
+    policy = new_policy;
+#endif
+    policy_configured = 1;
 }
 
 
 /*
  * main() simply parses command line arguments, then calls start_simulator().
- * You will need to modify it to support the -r and -s command-line parameters.
+ * Every registered policy adds its own flag to the getopt() string.
  */
 int main(int argc, char *argv[])
 {
-    //Parse scheduler type
-    if(strcmp(argv[1],"-f") == 0) {
-        scheduler_type = FCFS;
-    } else if (strcmp(argv[1],"-p") == 0) {
-        scheduler_type = PRIORITYQ;
-    } else if (strcmp(argv[1],"-s") == 0) {
-        scheduler_type = SJF;
-    } else {
-        printf("Must input a correct scheduler type!");
+    const sched_policy_t *const *p;
+    char optstring[64] = "P:M:liaceudkb";
+    char *arg;
+    int opt;
+    int report_locks = 0;
+    int migration_cost_set = 0;
+    int audit_fcfs = 0;
+    unsigned int sim_flags = 0;
+
+    for (p = sched_policies; *p != NULL; p++) {
+        size_t len = strlen(optstring);
+        assert(len + 2 < sizeof(optstring));
+        optstring[len] = (*p)->option;
+        optstring[len + 1] = (*p)->arg != NULL ? ':' : '\0';
+        optstring[len + 2] = '\0';
+    }
+
+    //Parse scheduler type and options
+#ifndef SCHED_POLICY
+    policy = sched_policies[0];
+#endif
+    while ((opt = getopt(argc, argv, optstring)) != -1) {
+        switch (opt) {
+        case 'P':
+            arg = strchr(optarg, '=');
+            if (arg != NULL) {
+                *arg++ = '\0';
+            }
+            select_policy(argv[0], sched_find(optarg), arg);
+            break;
+        case 'M':
+            migration_cost = (unsigned int)atoi(optarg);
+            migration_cost_set = 1;
+            break;
+        case 'l':
+            per_cpu_queues = 1;
+            break;
+        case 'i':
+            use_inbox = 1;
+            break;
+        case 'a':
+            audit_fcfs = 1;
+            break;
+        case 'c':
+            report_locks = 1;
+            break;
+        case 'e':
+            sim_flags |= SIM_EVENT_DRIVEN;
+            break;
+        case 'u':
+            sim_flags |= SIM_UNTHROTTLED;
+            break;
+        case 'd':
+            sim_flags |= SIM_INLINE;
+            idle_returns = 1;
+            break;
+        case 'k':
+            sim_flags |= SIM_COROUTINES;
+            break;
+        case 'b':
+            sim_flags |= SIM_PARALLEL;
+            break;
+        default:
+            if (opt == '?' || sched_find_option((char)opt) == NULL) {
+                usage(argv[0]);
+            }
+            select_policy(argv[0], sched_find_option((char)opt), optarg);
+        }
     }
     //Parse cpu_count (sim has handler)
-    cpu_count = atoi(argv[2]);
+    // A policy that takes an argument can only be the default if given it
+    if (optind != argc - 1 || (policy->arg != NULL && !policy_configured)) {
+        usage(argv[0]);
+    }
+    // -M only means something with per-CPU run queues, -a only with FCFS
+    if (migration_cost_set && !per_cpu_queues) {
+        fprintf(stderr, "-M needs per-CPU run queues (-l)\n\n");
+        usage(argv[0]);
+    }
+    if (audit_fcfs && (strcmp(policy->name, "fcfs") != 0 || policy->configure("audit"))) {
+        fprintf(stderr, "-a only applies to the FCFS scheduler\n\n");
+        usage(argv[0]);
+    }
+    cpu_count = (unsigned int)atoi(argv[optind]);
     // Allocate the running_processes[] array and its mutex */
     running_processes = malloc(sizeof(pcb_t*) * cpu_count);
-    for(int i = 0; i < cpu_count; i++) {
+    assert(running_processes != NULL);
+    for(unsigned int i = 0; i < cpu_count; i++) {
         running_processes[i] = NULL;
     }
-    // Define the Head of Ready Queue
-    readyQHead = malloc(sizeof(pcb_t*));
-    readyQHead = NULL;
-    assert(running_processes != NULL);
+    preempt_forced = calloc(cpu_count, sizeof(int));
+    assert(preempt_forced != NULL);
     pthread_mutex_init(&running_processes_mutex, NULL);
-    pthread_mutex_init(&queue_mutex, NULL);
-    pthread_cond_init(&queue_not_empty, NULL);
+    if (report_locks) {
+        lockstat_enable(cpu_count + 1);
+    }
+    lockstat_register(&running_processes_stats, "running_processes", -1);
+    if (policy->init != NULL) {
+        policy->init();
+    }
+
+    // Define the Ready Queues
+    nr_runqueues = per_cpu_queues ? cpu_count : 1;
+    runqueues = calloc(nr_runqueues, sizeof(runqueue_t));
+    assert(runqueues != NULL);
+    for (unsigned int i = 0; i < nr_runqueues; i++) {
+        pthread_mutex_init(&runqueues[i].mutex, NULL);
+        lockstat_register(&runqueues[i].stats, "runqueue", (int)i);
+        runqueues[i].queue = policy->rq_create();
+    }
+    idle_mask_words = (cpu_count + (unsigned int)IDLE_MASK_BITS - 1) / (unsigned int)IDLE_MASK_BITS;
+    idle_mask = calloc(idle_mask_words, sizeof(unsigned long));
+    assert(idle_mask != NULL);
 
     /* Start the simulator in the library */
+    set_simulator_flags(sim_flags);
     start_simulator(cpu_count);
-    free(readyQHead);
     return 0;
 }
-
@@ -18,4 +18,20 @@ extern void yield(unsigned int cpu_id);
 extern void terminate(unsigned int cpu_id);
 extern void wake_up(pcb_t *process);
 
+/*
+ * wake_up_batch() is wake_up() for every process that became ready in one
+ * tick, in the order they did.  The simulator calls it instead of wake_up().
+ */
+extern void wake_up_batch(pcb_t **batch, unsigned int count);
+
+/*
+ * processes_ready() returns how many processes are READY, counting those a
+ * CPU has taken off a run queue but not yet dispatched.  It takes no locks,
+ * so the simulator may call it at any time.
+ */
+extern unsigned int processes_ready(void);
+
+/* Called once at the end of the run, after the simulator's own statistics */
+extern void print_scheduler_stats(void);
+
 #endif /* __STUDENT_H__ */